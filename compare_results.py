@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+
+"""Compares a pfifo_cache1_test results file against a stored baseline.
+
+Either input may be the JSON lines file written to the Xbox (see
+PFIFO_WRITE_RESULTS_FILE) or a raw debug log containing "RESULT {...}" lines.
+If an input contains multiple runs, the median of each metric is used.
+
+Exits with 1 if any metric regressed beyond the noise thresholds, 2 on usage
+errors or (with --require-same-identity) if the runs were gathered on
+different hardware/emulators.
+"""
+
+import argparse
+import json
+import statistics
+import sys
+
+IDENTITY_KEYS = ("platform", "pmc_boot_0", "kernel")
+
+
+class Results:
+    def __init__(self):
+        self.runs = []
+        # (test, scenario, metric) -> {"values": [...], "unit": str, "better": str}
+        self.metrics = {}
+
+    def add(self, record):
+        record_type = record.get("type")
+        if record_type == "run":
+            self.runs.append(record)
+            return
+
+        if record_type != "metric":
+            return
+
+        key = (record["test"], record["scenario"], record["metric"])
+        entry = self.metrics.setdefault(
+            key,
+            {"values": [], "unit": record.get("unit", ""), "better": record.get("better", "lower")},
+        )
+        entry["values"].append(record["value"])
+
+    def identity(self):
+        if not self.runs:
+            return {}
+        return {key: self.runs[-1].get(key, "") for key in IDENTITY_KEYS}
+
+
+def load_results(file_path):
+    results = Results()
+    with open(file_path, "r") as f:
+        for line_number, line in enumerate(f, 1):
+            payload_start = line.find("RESULT {")
+            if payload_start >= 0:
+                payload = line[payload_start + len("RESULT ") :]
+            elif line.lstrip().startswith("{"):
+                payload = line
+            else:
+                continue
+
+            try:
+                record = json.loads(payload.strip())
+            except json.JSONDecodeError as err:
+                print(f"Warning: {file_path}:{line_number}: ignoring malformed result: {err}", file=sys.stderr)
+                continue
+            results.add(record)
+
+    return results
+
+
+def parse_metric_thresholds(values):
+    thresholds = {}
+    for value in values or []:
+        name, _, percent = value.partition("=")
+        if not percent:
+            raise ValueError(f"Invalid --metric-threshold '{value}', expected <metric>=<percent>")
+        thresholds[name] = float(percent)
+    return thresholds
+
+
+def compare(baseline, current, threshold_percent, absolute_threshold, metric_thresholds):
+    """Returns a list of (status, key, baseline_value, current_value, delta_percent, unit)."""
+    rows = []
+    for key in sorted(set(baseline.metrics) | set(current.metrics)):
+        base_entry = baseline.metrics.get(key)
+        cur_entry = current.metrics.get(key)
+        if not base_entry:
+            rows.append(("new", key, None, statistics.median(cur_entry["values"]), None, cur_entry["unit"]))
+            continue
+        if not cur_entry:
+            rows.append(("missing", key, statistics.median(base_entry["values"]), None, None, base_entry["unit"]))
+            continue
+
+        base_value = statistics.median(base_entry["values"])
+        cur_value = statistics.median(cur_entry["values"])
+        delta = cur_value - base_value
+        delta_percent = (delta * 100.0 / base_value) if base_value else None
+
+        percent = metric_thresholds.get(key[2], threshold_percent)
+        noise = max(abs(base_value) * percent / 100.0, absolute_threshold)
+
+        if abs(delta) <= noise:
+            status = "ok"
+        else:
+            worse = delta > 0 if base_entry["better"] == "lower" else delta < 0
+            status = "REGRESSION" if worse else "improved"
+
+        rows.append((status, key, base_value, cur_value, delta_percent, base_entry["unit"]))
+
+    return rows
+
+
+def format_value(value):
+    if value is None:
+        return "-"
+    if isinstance(value, float) and not value.is_integer():
+        return f"{value:.1f}"
+    return str(int(value))
+
+
+def print_report(rows, verbose):
+    for status, key, base_value, cur_value, delta_percent, unit in rows:
+        if status == "ok" and not verbose:
+            continue
+        test, scenario, metric = key
+        delta_str = "" if delta_percent is None else f" ({delta_percent:+.1f}%)"
+        print(
+            f"{status:>10}  {test}/{scenario}/{metric}: "
+            f"{format_value(base_value)} -> {format_value(cur_value)} {unit}{delta_str}"
+        )
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline", help="Baseline results file or debug log")
+    parser.add_argument("current", help="Results file or debug log to check")
+    parser.add_argument(
+        "--threshold-percent",
+        type=float,
+        default=5.0,
+        help="Relative change below which a metric is considered noise (default: %(default)s)",
+    )
+    parser.add_argument(
+        "--absolute-threshold",
+        type=float,
+        default=0.0,
+        help="Absolute change below which a metric is considered noise (default: %(default)s)",
+    )
+    parser.add_argument(
+        "--metric-threshold",
+        action="append",
+        metavar="METRIC=PERCENT",
+        help="Overrides --threshold-percent for a specific metric name (may be repeated)",
+    )
+    parser.add_argument(
+        "--require-same-identity",
+        action="store_true",
+        help="Fail if the runs were gathered on different hardware/emulators",
+    )
+    parser.add_argument(
+        "--fail-on-missing",
+        action="store_true",
+        help="Treat baseline metrics missing from the current run as regressions",
+    )
+    parser.add_argument("-v", "--verbose", action="store_true", help="Also print metrics within the noise threshold")
+    args = parser.parse_args()
+
+    try:
+        metric_thresholds = parse_metric_thresholds(args.metric_threshold)
+        baseline = load_results(args.baseline)
+        current = load_results(args.current)
+    except (OSError, ValueError) as err:
+        print(f"Error: {err}", file=sys.stderr)
+        return 2
+
+    if not baseline.metrics:
+        print(f"Error: no results found in '{args.baseline}'", file=sys.stderr)
+        return 2
+    if not current.metrics:
+        print(f"Error: no results found in '{args.current}'", file=sys.stderr)
+        return 2
+
+    baseline_identity = baseline.identity()
+    current_identity = current.identity()
+    if baseline_identity != current_identity:
+        print(f"Warning: identity mismatch: baseline {baseline_identity} current {current_identity}")
+        if args.require_same_identity:
+            return 2
+
+    rows = compare(baseline, current, args.threshold_percent, args.absolute_threshold, metric_thresholds)
+    print_report(rows, args.verbose)
+
+    regressions = sum(1 for row in rows if row[0] == "REGRESSION")
+    missing = sum(1 for row in rows if row[0] == "missing")
+    print(f"\n{len(rows)} metrics compared, {regressions} regressions, {missing} missing")
+
+    if regressions or (missing and args.fail_on_missing):
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+
+"""Runs compare_results.py against the recorded results in testdata/compare_results.
+
+Usage: python3 compare_results_test.py
+"""
+
+import os
+import subprocess
+import sys
+import unittest
+
+ROOT = os.path.dirname(os.path.abspath(__file__))
+SCRIPT = os.path.join(ROOT, "compare_results.py")
+DATA_DIR = os.path.join(ROOT, "testdata", "compare_results")
+BASELINE = os.path.join(DATA_DIR, "baseline.jsonl")
+
+
+def run_compare(current, *args):
+    result = subprocess.run(
+        [sys.executable, SCRIPT, BASELINE, os.path.join(DATA_DIR, current), *args],
+        capture_output=True,
+        text=True,
+    )
+    return result.returncode, result.stdout
+
+
+class CompareResultsTest(unittest.TestCase):
+    def test_within_noise_from_debug_log(self):
+        returncode, output = run_compare("current_ok.log")
+        self.assertEqual(returncode, 0, output)
+        self.assertIn("3 metrics compared, 0 regressions, 0 missing", output)
+
+    def test_regression(self):
+        returncode, output = run_compare("current_regression.jsonl")
+        self.assertEqual(returncode, 1, output)
+        self.assertIn("REGRESSION  CompareWaitForIdleAndNopTime/nop/drain_ticks: 1010 -> 1200", output)
+
+    def test_regression_within_metric_threshold(self):
+        returncode, output = run_compare("current_regression.jsonl", "--metric-threshold", "drain_ticks=25")
+        self.assertEqual(returncode, 0, output)
+
+    def test_improvement(self):
+        returncode, output = run_compare("current_improved.jsonl")
+        self.assertEqual(returncode, 0, output)
+        self.assertIn("improved  CompareWaitForIdleAndNopTime/nop/drain_ticks", output)
+        self.assertIn("improved  PfifoSoak/nop/words_per_mtick", output)
+
+    def test_missing(self):
+        returncode, output = run_compare("current_missing.jsonl")
+        self.assertEqual(returncode, 0, output)
+        self.assertIn("missing  CompareWaitForIdleAndNopTime/wait_for_idle/drain_ticks", output)
+
+        returncode, output = run_compare("current_missing.jsonl", "--fail-on-missing")
+        self.assertEqual(returncode, 1, output)
+
+    def test_identity_mismatch(self):
+        returncode, output = run_compare("current_other_platform.jsonl")
+        self.assertEqual(returncode, 0, output)
+        self.assertIn("Warning: identity mismatch", output)
+
+        returncode, output = run_compare("current_other_platform.jsonl", "--require-same-identity")
+        self.assertEqual(returncode, 2, output)
+
+    def test_median_of_runs(self):
+        # Both inputs contain a single outlier run that the median discards.
+        returncode, output = run_compare("current_median_of_runs.jsonl", "--verbose")
+        self.assertEqual(returncode, 0, output)
+        self.assertIn("ok  CompareWaitForIdleAndNopTime/nop/drain_ticks: 1010 -> 1020", output)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,408 @@
+#!/usr/bin/env python3
+
+"""Compares DMA/CACHE1 traces of the same tests captured on two systems.
+
+Intended for comparing real hardware against xemu. Each input is a debug log
+(raw "DebugStr ... text:" lines or plain DbgPrint output) from
+pfifo_cache1_test. Tests are matched by their "== Name ==" header and phases
+within a test are matched by their trace markers ("@<ticks> MARK <label>").
+
+For each matched phase the tool reports:
+  * register states that only appear in one trace (e.g., PUSH0/PULL0 values
+    the emulator never produces),
+  * where the sequence of state transitions diverges, aligned by DMA GET
+    progress when both traces include it,
+  * phase durations and how long the DMA GET took to reach the final PUT.
+
+The pushbuffer is not necessarily at the same physical address on both systems
+(e.g., xemu configured with 128 MB of RAM), and the first GET sampled after a
+submission depends on how quickly each system's pusher started. GET progress
+is therefore compared as the distance remaining to the final DMA PUT of each
+phase, which only depends on the pushbuffer contents.
+
+Exits with 1 if --fail-on-divergence is given and any divergence was found.
+"""
+
+import argparse
+import difflib
+import re
+import sys
+
+DEBUG_STR_PATTERN = re.compile(r"^DebugStr.*?text:\s+(.*)")
+TEST_START_PATTERN = re.compile(r"^==\s+(\w+)\s+==")
+MARKER_PATTERN = re.compile(r"^@(\d+)\s+MARK\s+(\S+)")
+STATE_PATTERN = re.compile(r"^@(\d+)\s+(.*)")
+REGISTER_PATTERN = re.compile(r"(\w+)=0x([0-9A-Fa-f]+)")
+# Decoded bitfields, e.g. "{ACCESS=1 BUSY=0}", are redundant with the raw value.
+DECODED_FIELDS_PATTERN = re.compile(r"\{[^}]*\}")
+REPEAT_PATTERN = re.compile(r"^\.\.\. repeated (\d+) times")
+DROPPED_PATTERN = re.compile(r"^\.\.\. dropped (\d+) records")
+
+# Registers that track progress through the pushbuffer rather than pusher/puller
+# state. They are compared via timing instead of as part of the state sequence.
+POINTER_REGISTERS = ("DMA_GET", "DMA_PUT", "CACHE1_GET", "CACHE1_PUT")
+
+INITIAL_PHASE = "<start>"
+
+
+class Phase:
+    def __init__(self, label, timestamp):
+        self.label = label
+        self.start = timestamp
+        # List of (timestamp, {register: value}, repeats)
+        self.states = []
+        self.end = timestamp
+        # Number of records the logger discarded because its ring was full.
+        self.dropped = 0
+
+    def duration(self):
+        if self.start is None or self.end is None:
+            return None
+        return self.end - self.start
+
+
+def payloads(file_path):
+    with open(file_path, "r") as f:
+        for line in f:
+            line = line.strip()
+            match = DEBUG_STR_PATTERN.search(line)
+            yield match.group(1).strip() if match else line
+
+
+def parse_trace(file_path):
+    """Returns {test_name: [Phase, ...]} in the order encountered."""
+    tests = {}
+    phases = None
+
+    for payload in payloads(file_path):
+        match = TEST_START_PATTERN.match(payload)
+        if match:
+            phases = [Phase(INITIAL_PHASE, None)]
+            tests[match.group(1)] = phases
+            continue
+
+        if phases is None:
+            continue
+
+        match = MARKER_PATTERN.match(payload)
+        if match:
+            timestamp = int(match.group(1))
+            phases[-1].end = timestamp
+            phases.append(Phase(match.group(2), timestamp))
+            continue
+
+        match = REPEAT_PATTERN.match(payload)
+        if match and phases[-1].states:
+            timestamp, registers, repeats = phases[-1].states[-1]
+            phases[-1].states[-1] = (timestamp, registers, repeats + int(match.group(1)))
+            continue
+
+        match = DROPPED_PATTERN.match(payload)
+        if match:
+            phases[-1].dropped += int(match.group(1))
+            continue
+
+        match = STATE_PATTERN.match(payload)
+        if not match:
+            continue
+
+        raw_registers = DECODED_FIELDS_PATTERN.sub("", match.group(2))
+        registers = {name: int(value, 16) for name, value in REGISTER_PATTERN.findall(raw_registers)}
+        if not registers:
+            continue
+
+        timestamp = int(match.group(1))
+        phase = phases[-1]
+        if phase.start is None:
+            phase.start = timestamp
+        phase.end = timestamp
+        phase.states.append((timestamp, registers, 0))
+
+    return tests
+
+
+def control_state(registers, ignored):
+    return tuple(
+        (name, value) for name, value in registers.items() if name not in POINTER_REGISTERS and name not in ignored
+    )
+
+
+def control_sequence(phase, ignored):
+    """Returns the phase's states without pointer registers, with consecutive duplicates removed."""
+    sequence = []
+    for _, registers, _ in phase.states:
+        state = control_state(registers, ignored)
+        if not sequence or sequence[-1] != state:
+            sequence.append(state)
+    return sequence
+
+
+def final_put(phase):
+    """Returns the last DMA_PUT observed in the phase, or None if the trace does not include it."""
+    for _, registers, _ in reversed(phase.states):
+        if "DMA_PUT" in registers:
+            return registers["DMA_PUT"]
+    return None
+
+
+def get_offsets(phase):
+    """Yields (timestamp, registers, GET offset) for the phase's states that include DMA_GET.
+
+    Offsets are the number of bytes DMA_GET still had to advance to reach the phase's final PUT.
+    """
+    put = final_put(phase)
+    if put is None:
+        return
+    for timestamp, registers, _ in phase.states:
+        dma_get = registers.get("DMA_GET")
+        if dma_get is not None:
+            yield timestamp, registers, put - dma_get
+
+
+def control_sequence_by_get(phase, ignored):
+    """Returns {GET offset: control states observed at that offset} with consecutive duplicates removed."""
+    sequences = {}
+    for _, registers, offset in get_offsets(phase):
+        sequence = sequences.setdefault(offset, [])
+        state = control_state(registers, ignored)
+        if not sequence or sequence[-1] != state:
+            sequence.append(state)
+    return sequences
+
+
+def format_state(state):
+    return " ".join(f"{name}=0x{value:08X}" for name, value in state)
+
+
+def register_values(sequence):
+    values = {}
+    for state in sequence:
+        for name, value in state:
+            values.setdefault(name, set()).add(value)
+    return values
+
+
+def time_to_final_put(phase):
+    """Returns the ticks from the start of the phase until DMA_GET reached the last observed DMA_PUT."""
+    if not phase.states or phase.start is None:
+        return None
+    for timestamp, _, offset in get_offsets(phase):
+        if not offset:
+            return timestamp - phase.start
+    return None
+
+
+def get_progress(phase):
+    """Returns {GET offset: ticks since phase start} for the first time each GET offset was observed."""
+    progress = {}
+    if phase.start is None:
+        return progress
+    for timestamp, _, offset in get_offsets(phase):
+        if offset not in progress:
+            progress[offset] = timestamp - phase.start
+    return progress
+
+
+def format_offset(offset):
+    """Formats a GET offset relative to the final PUT, e.g. "PUT-0x40"."""
+    if not offset:
+        return "PUT"
+    return f"PUT-{offset:#x}" if offset > 0 else f"PUT+{-offset:#x}"
+
+
+def format_ticks(value):
+    return "-" if value is None else str(value)
+
+
+def format_ratio(a, b):
+    if a is None or b is None or not a:
+        return ""
+    return f" (x{b / a:.2f})"
+
+
+def compare_phase(phase_a, phase_b, names, ignored, max_transitions):
+    """Prints a report for a single pair of phases and returns the number of divergences."""
+    divergences = 0
+    name_a, name_b = names
+
+    for phase, name in ((phase_a, name_a), (phase_b, name_b)):
+        if phase.dropped:
+            print(f"    warning: {phase.dropped} records dropped in {name}, the comparison is incomplete")
+
+    duration_a = phase_a.duration()
+    duration_b = phase_b.duration()
+    print(
+        f"    duration: {name_a} {format_ticks(duration_a)} {name_b} {format_ticks(duration_b)}"
+        f"{format_ratio(duration_a, duration_b)}"
+    )
+
+    drain_a = time_to_final_put(phase_a)
+    drain_b = time_to_final_put(phase_b)
+    if drain_a is not None or drain_b is not None:
+        print(
+            f"    GET reached PUT after: {name_a} {format_ticks(drain_a)} {name_b} {format_ticks(drain_b)}"
+            f"{format_ratio(drain_a, drain_b)}"
+        )
+
+    progress_a = get_progress(phase_a)
+    progress_b = get_progress(phase_b)
+    common_gets = sorted(set(progress_a) & set(progress_b))
+    print(
+        f"    distinct DMA_GET offsets: {name_a} {len(progress_a)} {name_b} {len(progress_b)} "
+        f"common {len(common_gets)}"
+    )
+    if common_gets:
+        worst = max(common_gets, key=lambda get: abs(progress_b[get] - progress_a[get]))
+        print(
+            f"    largest GET timing gap: {format_offset(worst)} reached at {name_a} {progress_a[worst]} "
+            f"{name_b} {progress_b[worst]}"
+        )
+
+    sequence_a = control_sequence(phase_a, ignored)
+    sequence_b = control_sequence(phase_b, ignored)
+
+    values_a = register_values(sequence_a)
+    values_b = register_values(sequence_b)
+    for register in sorted(set(values_a) | set(values_b)):
+        only_a = values_a.get(register, set()) - values_b.get(register, set())
+        only_b = values_b.get(register, set()) - values_a.get(register, set())
+        for only, name in ((only_a, name_a), (only_b, name_b)):
+            if only:
+                divergences += 1
+                formatted = ", ".join(f"0x{value:08X}" for value in sorted(only))
+                print(f"    {register} values only seen on {name}: {formatted}")
+
+    if common_gets:
+        return divergences + compare_sequences_by_get(phase_a, phase_b, common_gets, names, ignored, max_transitions)
+
+    matcher = difflib.SequenceMatcher(a=sequence_a, b=sequence_b, autojunk=False)
+    if matcher.ratio() < 1.0:
+        divergences += 1
+        print(
+            f"    state transitions: {name_a} {len(sequence_a)} {name_b} {len(sequence_b)} "
+            f"similarity {matcher.ratio():.2f}"
+        )
+        for tag, a_start, a_end, b_start, b_end in matcher.get_opcodes():
+            if tag == "equal":
+                continue
+            for index in range(a_start, min(a_end, a_start + max_transitions)):
+                print(f"      - {name_a}[{index}] {format_state(sequence_a[index])}")
+            for index in range(b_start, min(b_end, b_start + max_transitions)):
+                print(f"      + {name_b}[{index}] {format_state(sequence_b[index])}")
+
+    return divergences
+
+
+def compare_sequences_by_get(phase_a, phase_b, common_gets, names, ignored, max_transitions):
+    """Compares the state transitions seen at each GET offset observed in both phases.
+
+    Offsets only one side sampled are skipped, so differing sample rates do not show up as divergences.
+    """
+    name_a, name_b = names
+    by_get_a = control_sequence_by_get(phase_a, ignored)
+    by_get_b = control_sequence_by_get(phase_b, ignored)
+    differing = [get for get in common_gets if by_get_a[get] != by_get_b[get]]
+    if not differing:
+        return 0
+
+    print(f"    state transitions differ at {len(differing)} of {len(common_gets)} common GET offsets")
+    for get in differing[:max_transitions]:
+        print(f"      at GET {format_offset(get)}:")
+        for index, state in enumerate(by_get_a[get][:max_transitions]):
+            print(f"        - {name_a}[{index}] {format_state(state)}")
+        for index, state in enumerate(by_get_b[get][:max_transitions]):
+            print(f"        + {name_b}[{index}] {format_state(state)}")
+    return 1
+
+
+def compare_test(test_name, phases_a, phases_b, names, ignored, max_transitions):
+    print(f"== {test_name} ==")
+    divergences = 0
+
+    labels_a = [phase.label for phase in phases_a]
+    labels_b = [phase.label for phase in phases_b]
+    matcher = difflib.SequenceMatcher(a=labels_a, b=labels_b, autojunk=False)
+    for tag, a_start, a_end, b_start, b_end in matcher.get_opcodes():
+        if tag != "equal":
+            divergences += 1
+            print(f"  phase mismatch: {name_list(labels_a[a_start:a_end])} vs {name_list(labels_b[b_start:b_end])}")
+            continue
+
+        for phase_a, phase_b in zip(phases_a[a_start:a_end], phases_b[b_start:b_end]):
+            if not phase_a.states and not phase_b.states:
+                continue
+            print(f"  phase {phase_a.label}")
+            divergences += compare_phase(phase_a, phase_b, names, ignored, max_transitions)
+
+    print()
+    return divergences
+
+
+def name_list(labels):
+    return "[" + ", ".join(labels) + "]" if labels else "[]"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("trace_a", help="Debug log from the first system (e.g., hardware)")
+    parser.add_argument("trace_b", help="Debug log from the second system (e.g., xemu)")
+    parser.add_argument(
+        "--names",
+        nargs=2,
+        default=("A", "B"),
+        metavar=("NAME_A", "NAME_B"),
+        help="Labels used for the two traces in the report",
+    )
+    parser.add_argument("--test", action="append", help="Only compare the given test (may be repeated)")
+    parser.add_argument(
+        "--ignore-register",
+        action="append",
+        default=[],
+        help="Exclude a register from the state sequence comparison (may be repeated)",
+    )
+    parser.add_argument(
+        "--max-transitions",
+        type=int,
+        default=8,
+        help="Maximum number of differing states printed per divergence (default: %(default)s)",
+    )
+    parser.add_argument(
+        "--fail-on-divergence", action="store_true", help="Exit with 1 if any divergence is found"
+    )
+    args = parser.parse_args()
+
+    try:
+        tests_a = parse_trace(args.trace_a)
+        tests_b = parse_trace(args.trace_b)
+    except OSError as err:
+        print(f"Error: {err}", file=sys.stderr)
+        return 2
+
+    names = tuple(args.names)
+    ignored = set(args.ignore_register)
+    divergences = 0
+
+    for test_name in tests_a:
+        if args.test and test_name not in args.test:
+            continue
+        if test_name not in tests_b:
+            print(f"== {test_name} == only present in {names[0]}\n")
+            divergences += 1
+            continue
+        divergences += compare_test(
+            test_name, tests_a[test_name], tests_b[test_name], names, ignored, args.max_transitions
+        )
+
+    for test_name in tests_b:
+        if test_name not in tests_a and (not args.test or test_name in args.test):
+            print(f"== {test_name} == only present in {names[1]}\n")
+            divergences += 1
+
+    print(f"{divergences} divergences")
+    if divergences and args.fail_on_divergence:
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+
+"""Runs diff_traces.py against the recorded traces in testdata/diff_traces.
+
+hw.log and xemu.log contain the same tests. In xemu.log the pushbuffer is at a different physical address, the
+pusher has already advanced when the first state is sampled, one phase contains dropped records and one phase is
+missing.
+
+Usage: python3 diff_traces_test.py
+"""
+
+import os
+import subprocess
+import sys
+import unittest
+
+ROOT = os.path.dirname(os.path.abspath(__file__))
+SCRIPT = os.path.join(ROOT, "diff_traces.py")
+DATA_DIR = os.path.join(ROOT, "testdata", "diff_traces")
+HW_TRACE = os.path.join(DATA_DIR, "hw.log")
+XEMU_TRACE = os.path.join(DATA_DIR, "xemu.log")
+
+
+def run_diff(*args, trace_a=HW_TRACE, trace_b=XEMU_TRACE):
+    result = subprocess.run(
+        [sys.executable, SCRIPT, trace_a, trace_b, "--names", "hw", "xemu", *args],
+        capture_output=True,
+        text=True,
+    )
+    return result.returncode, result.stdout
+
+
+class DiffTracesTest(unittest.TestCase):
+    def test_phases_aligned_by_marker(self):
+        returncode, output = run_diff("--test", "TestLoopedBatchingWithoutWaitForIdle")
+        self.assertEqual(returncode, 0, output)
+        self.assertIn("  phase submission_0\n", output)
+        self.assertIn("  phase mismatch: [submission_1] vs []\n", output)
+        self.assertIn("  phase after_final_sleep\n", output)
+        self.assertIn("1 divergences", output)
+
+    def test_value_only_seen_on_one_side(self):
+        returncode, output = run_diff("--test", "CompareWaitForIdleAndNopTimeWithClears")
+        self.assertEqual(returncode, 0, output)
+        self.assertIn("PULL0 values only seen on hw: 0x00000011", output)
+        self.assertIn("state transitions differ at 1 of 3 common GET offsets", output)
+        self.assertIn("at GET PUT-0xc8:", output)
+
+    def test_pushbuffer_at_different_address(self):
+        # xemu's pushbuffer is at a different address and its first sample is taken after GET already advanced.
+        returncode, output = run_diff("--test", "CompareWaitForIdleAndNopTime")
+        self.assertEqual(returncode, 0, output)
+        self.assertIn("GET reached PUT after: hw 200 xemu 280 (x1.40)", output)
+        self.assertIn("distinct DMA_GET offsets: hw 3 xemu 2 common 2", output)
+        self.assertIn("largest GET timing gap: PUT reached at hw 200 xemu 280", output)
+        self.assertNotIn("state transitions differ", output)
+        self.assertIn("0 divergences", output)
+
+    def test_phase_with_drops(self):
+        returncode, output = run_diff("--test", "TestVeryLargeFlatBufferWithNoWait")
+        self.assertEqual(returncode, 0, output)
+        self.assertIn("warning: 7 records dropped in xemu, the comparison is incomplete", output)
+
+    def test_fail_on_divergence(self):
+        returncode, output = run_diff("--fail-on-divergence")
+        self.assertEqual(returncode, 1, output)
+        self.assertIn("3 divergences", output)
+
+        returncode, output = run_diff("--fail-on-divergence", trace_b=HW_TRACE)
+        self.assertEqual(returncode, 0, output)
+        self.assertIn("0 divergences", output)
+
+
+if __name__ == "__main__":
+    unittest.main()
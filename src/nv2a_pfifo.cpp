@@ -0,0 +1,40 @@
+#include "nv2a_pfifo.h"
+
+extern "C" {
+extern uint32_t* pb_Put;
+}
+
+static volatile DWORD* USER_DMA_PUT =
+    reinterpret_cast<DWORD*>(VIDEO_BASE + NV_USER + 0x40);
+
+static void pb_cache_flush() {
+  __asm__ __volatile__("sfence");
+  // assembler instruction "sfence" : waits end of previous instructions
+
+  VIDEOREG(NV_PFB_WC_CACHE) |= NV_PFB_WC_CACHE_FLUSH_TRIGGER;
+  while (VIDEOREG(NV_PFB_WC_CACHE) & NV_PFB_WC_CACHE_FLUSH_IN_PROGRESS) {
+  };
+}
+
+void CommitPushbuffer(uint32_t* p) {
+  pb_Put = p;
+  pb_cache_flush();
+  *USER_DMA_PUT = reinterpret_cast<DWORD>(pb_Put) & 0x03FFFFFF;
+}
+
+void EmptyCache1() {
+  auto p = pb_begin();
+  p = pb_push1(p, NV097_NO_OPERATION, 1);
+  p = pb_push1(p, NV097_NO_OPERATION, 1);
+  p = pb_push1(p, NV097_NO_OPERATION, 1);
+  p = pb_push1(p, NV097_NO_OPERATION, 1);
+  p = pb_push1(p, NV097_NO_OPERATION, 1);
+  p = pb_push1(p, NV097_NO_OPERATION, 1);
+  p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
+  CommitPushbuffer(p);
+  for (auto i = 0; i < 0x800 && !(ReadDWORD(CACHE1_STATUS) &
+                                  NV_PFIFO_CACHE1_STATUS_LOW_MARK_EMPTY);
+       ++i) {
+    Sleep(1);
+  }
+}
@@ -0,0 +1,117 @@
+#ifndef NV2A_PFIFO_H_
+#define NV2A_PFIFO_H_
+
+#include <pbkit/pbkit.h>
+#include <windows.h>
+
+#include <cstdint>
+
+// mmio blocks
+#define NV2A_MMIO_BASE 0xFD000000
+#define BLOCK_PMC 0x000000
+#define BLOCK_PBUS 0x001000
+#define BLOCK_PFIFO 0x002000
+#define BLOCK_PRMA 0x007000
+#define BLOCK_PVIDEO 0x008000
+#define BLOCK_PTIMER 0x009000
+#define BLOCK_PCOUNTER 0x00A000
+#define BLOCK_PVPE 0x00B000
+#define BLOCK_PTV 0x00D000
+#define BLOCK_PRMFB 0x0A0000
+#define BLOCK_PRMVIO 0x0C0000
+#define BLOCK_PFB 0x100000
+#define BLOCK_PSTRAPS 0x101000
+#define BLOCK_PGRAPH 0x400000
+#define BLOCK_PCRTC 0x600000
+#define BLOCK_PRMCIO 0x601000
+#define BLOCK_PRAMDAC 0x680000
+#define BLOCK_PRMDIO 0x681000
+#define BLOCK_PRAMIN 0x700000
+#define BLOCK_USER 0x800000
+
+#define _PFIFO_ADDR(addr) (NV2A_MMIO_BASE + (addr))
+#define _PTIMER_ADDR(addr) (NV2A_MMIO_BASE + (addr))
+#define _PGRAPH_ADDR(addr) (NV2A_MMIO_BASE + (addr))
+
+#define PMC_BOOT_0 (NV2A_MMIO_BASE + BLOCK_PMC)
+
+#define DMA_STATE _PFIFO_ADDR(NV_PFIFO_CACHE1_DMA_STATE)
+#define DMA_PUT_ADDR _PFIFO_ADDR(NV_PFIFO_CACHE1_DMA_PUT)
+#define DMA_GET_ADDR _PFIFO_ADDR(NV_PFIFO_CACHE1_DMA_GET)
+#define DMA_SUBROUTINE _PFIFO_ADDR(NV_PFIFO_CACHE1_DMA_SUBROUTINE)
+
+#define CACHE1_PUSH0_STATE _PFIFO_ADDR(NV_PFIFO_CACHE1_PUSH0)
+#define CACHE1_DMA_PUSH_STATE _PFIFO_ADDR(NV_PFIFO_CACHE1_DMA_PUSH)
+#define CACHE1_PULL0_STATE _PFIFO_ADDR(NV_PFIFO_CACHE1_PULL0)
+#define CACHE_PUT_ADDR _PFIFO_ADDR(NV_PFIFO_CACHE1_PUT)
+#define CACHE_GET_ADDR _PFIFO_ADDR(NV_PFIFO_CACHE1_GET)
+#define CACHE1_STATUS _PFIFO_ADDR(NV_PFIFO_CACHE1_STATUS)
+
+#define CACHE1_METHOD _PFIFO_ADDR(NV_PFIFO_CACHE1_METHOD)
+#define CACHE1_DATA _PFIFO_ADDR(NV_PFIFO_CACHE1_DATA)
+#define RAM_HASHTABLE _PFIFO_ADDR(NV_PFIFO_RAMHT)
+
+#define CTX_SWITCH1 _PGRAPH_ADDR(NV_PGRAPH_CTX_SWITCH1)
+#define PGRAPH_STATE _PGRAPH_ADDR(NV_PGRAPH_FIFO)
+
+#define PTIMER_TIME_LOW _PTIMER_ADDR(NV_PTIMER_TIME_0)
+#define PTIMER_TIME_HIGH _PTIMER_ADDR(NV_PTIMER_TIME_1)
+
+inline uint32_t ReadDWORD(intptr_t address) {
+  return *(volatile uint32_t*)(address);
+}
+
+inline void WriteDWORD(intptr_t address, uint32_t value) {
+  *(volatile uint32_t*)(address) = value;
+}
+
+inline void GetNV2ATime(uint64_t* ret) {
+  *ret = ReadDWORD(PTIMER_TIME_HIGH);
+  *ret <<= 32;
+  *ret += ReadDWORD(PTIMER_TIME_LOW);
+}
+
+inline bool IsCache1Empty() {
+  if (ReadDWORD(CACHE1_STATUS) & NV_PFIFO_CACHE1_STATUS_LOW_MARK_EMPTY) {
+    return true;
+  }
+  return ReadDWORD(CACHE_GET_ADDR) == ReadDWORD(CACHE_PUT_ADDR);
+}
+
+inline bool SpinUntilEmptyCache1() {
+  static constexpr auto kMaxLoops = 0x7FFFFFF;
+  auto i = 0;
+  for (; i < kMaxLoops; ++i) {
+    if (IsCache1Empty()) {
+      break;
+    }
+  }
+  return i < kMaxLoops;
+}
+
+// Unlike IsCache1Empty, this also requires the DMA pusher to have consumed the
+// entire pushbuffer. CACHE1 is briefly empty right after the PUT is moved,
+// which would otherwise look like an instant drain.
+inline bool IsPushbufferDrained() {
+  return ReadDWORD(DMA_GET_ADDR) == ReadDWORD(DMA_PUT_ADDR) && IsCache1Empty();
+}
+
+inline bool SpinUntilPushbufferDrained() {
+  static constexpr auto kMaxLoops = 0x7FFFFFF;
+  auto i = 0;
+  for (; i < kMaxLoops; ++i) {
+    if (IsPushbufferDrained()) {
+      break;
+    }
+  }
+  return i < kMaxLoops;
+}
+
+// Flushes the write combining cache and moves the DMA PUT to `p`.
+void CommitPushbuffer(uint32_t* p);
+
+// Submits a few NOPs and a WAIT_FOR_IDLE and waits (up to ~2 seconds) for
+// CACHE1 to report empty.
+void EmptyCache1();
+
+#endif  // NV2A_PFIFO_H_
@@ -5,35 +5,15 @@
 #include <SDL.h>
 #include <hal/debug.h>
 #include <hal/video.h>
+#include <nxdk/mount.h>
 #include <pbkit/pbkit.h>
 #include <windows.h>
 
-// mmio blocks
-#define NV2A_MMIO_BASE 0xFD000000
-#define BLOCK_PMC 0x000000
-#define BLOCK_PBUS 0x001000
-#define BLOCK_PFIFO 0x002000
-#define BLOCK_PRMA 0x007000
-#define BLOCK_PVIDEO 0x008000
-#define BLOCK_PTIMER 0x009000
-#define BLOCK_PCOUNTER 0x00A000
-#define BLOCK_PVPE 0x00B000
-#define BLOCK_PTV 0x00D000
-#define BLOCK_PRMFB 0x0A0000
-#define BLOCK_PRMVIO 0x0C0000
-#define BLOCK_PFB 0x100000
-#define BLOCK_PSTRAPS 0x101000
-#define BLOCK_PGRAPH 0x400000
-#define BLOCK_PCRTC 0x600000
-#define BLOCK_PRMCIO 0x601000
-#define BLOCK_PRAMDAC 0x680000
-#define BLOCK_PRMDIO 0x681000
-#define BLOCK_PRAMIN 0x700000
-#define BLOCK_USER 0x800000
-
-#define _PFIFO_ADDR(addr) (NV2A_MMIO_BASE + (addr))
-#define _PTIMER_ADDR(addr) (NV2A_MMIO_BASE + (addr))
-// #define _PGRAPH_ADDR(addr) (NV2A_MMIO_BASE + BLOCK_PGRAPH + (addr))
+#include "configure.h"
+#include "nv2a_pfifo.h"
+#include "pfifo_soak.h"
+#include "results_writer.h"
+#include "trace_logger.h"
 
 extern "C" {
 extern DWORD pb_Size;
@@ -57,176 +37,61 @@ static const int kFramebufferWidth = 640;
 static const int kFramebufferHeight = 480;
 static const int kBitsPerPixel = 32;
 
-volatile DWORD* USER_DMA_PUT =
-    reinterpret_cast<DWORD*>(VIDEO_BASE + NV_USER + 0x40);
-volatile DWORD* USER_DMA_GET =
-    reinterpret_cast<DWORD*>(VIDEO_BASE + NV_USER + 0x44);
-
-#define DMA_STATE _PFIFO_ADDR(NV_PFIFO_CACHE1_DMA_STATE)
-#define DMA_PUT_ADDR _PFIFO_ADDR(NV_PFIFO_CACHE1_DMA_PUT)
-#define DMA_GET_ADDR _PFIFO_ADDR(NV_PFIFO_CACHE1_DMA_GET)
-#define DMA_SUBROUTINE _PFIFO_ADDR(NV_PFIFO_CACHE1_DMA_SUBROUTINE)
-
-#define CACHE1_PUSH0_STATE _PFIFO_ADDR(NV_PFIFO_CACHE1_PUSH0)
-#define CACHE1_DMA_PUSH_STATE _PFIFO_ADDR(NV_PFIFO_CACHE1_DMA_PUSH)
-#define CACHE1_PULL0_STATE _PFIFO_ADDR(NV_PFIFO_CACHE1_PULL0)
-#define CACHE_PUT_ADDR _PFIFO_ADDR(NV_PFIFO_CACHE1_PUT)
-#define CACHE_GET_ADDR _PFIFO_ADDR(NV_PFIFO_CACHE1_GET)
-#define CACHE1_STATUS _PFIFO_ADDR(NV_PFIFO_CACHE1_STATUS)
-
-#define CACHE1_METHOD _PFIFO_ADDR(NV_PFIFO_CACHE1_METHOD)
-#define CACHE1_DATA _PFIFO_ADDR(NV_PFIFO_CACHE1_DATA)
-#define RAM_HASHTABLE _PFIFO_ADDR(NV_PFIFO_RAMHT)
-
-#define CTX_SWITCH1 _PGRAPH_ADDR(NV_PGRAPH_CTX_SWITCH1)
-#define PGRAPH_STATE _PGRAPH_ADDR(NV_PGRAPH_FIFO)
-
-#define PTIMER_TIME_LOW _PTIMER_ADDR(NV_PTIMER_TIME_0)
-#define PTIMER_TIME_HIGH _PTIMER_ADDR(NV_PTIMER_TIME_1)
-
 #define NV2A_PROFILE_DECLARE() uint64_t __start_time, __end_time
 #define NV2A_PROFILE_START() GetNV2ATime(&__start_time)
 #define NV2A_PROFILE_END(delta_variable_name) \
   GetNV2ATime(&__end_time);                   \
   delta_variable_name = __end_time - __start_time
 
-inline uint32_t ReadDWORD(intptr_t address) {
-  return *(volatile uint32_t*)(address);
-}
-
-inline void WriteDWORD(intptr_t address, uint32_t value) {
-  *(volatile uint32_t*)(address) = value;
-}
-
-static void pb_cache_flush() {
-  __asm__ __volatile__("sfence");
-  // assembler instruction "sfence" : waits end of previous instructions
-
-  VIDEOREG(NV_PFB_WC_CACHE) |= NV_PFB_WC_CACHE_FLUSH_TRIGGER;
-  while (VIDEOREG(NV_PFB_WC_CACHE) & NV_PFB_WC_CACHE_FLUSH_IN_PROGRESS) {
-  };
-}
-
-struct StateEntry {
-  DWORD dma_get;
-  DWORD dma_put;
-  DWORD cache_get;
-  DWORD cache_put;
-
-  DWORD dma_push_state;
-  DWORD cache1_push0_state;
-  DWORD cache1_pull0_state;
-  DWORD cache1_status;
-};
-
 static constexpr auto kStateBufferEntries = 4096;
-static StateEntry* default_state_buffer = nullptr;
-
-inline void FillStateBuffer(StateEntry* state_entry) {
-  for (auto i = 0; i < kStateBufferEntries; ++i, ++state_entry) {
-    state_entry->dma_get = ReadDWORD(DMA_GET_ADDR);
-    state_entry->dma_put = ReadDWORD(DMA_PUT_ADDR);
-    state_entry->cache_get = ReadDWORD(CACHE_GET_ADDR);
-    state_entry->cache_put = ReadDWORD(CACHE_PUT_ADDR);
-
-    state_entry->dma_push_state = ReadDWORD(CACHE1_DMA_PUSH_STATE);
-    state_entry->cache1_push0_state = ReadDWORD(CACHE1_PUSH0_STATE);
-    state_entry->cache1_pull0_state = ReadDWORD(CACHE1_PULL0_STATE);
-    state_entry->cache1_status = ReadDWORD(CACHE1_STATUS);
-  }
+static TraceLogger* trace_logger = nullptr;
+static ResultsWriter* results = nullptr;
+
+static void WriteDrainResults(const char* test, const char* scenario,
+                              bool emptied, uint64_t delta_time) {
+  results->WriteMetric(test, scenario, "emptied", emptied, "bool",
+                       ResultsWriter::Better::kHigher);
+  results->WriteMetric(test, scenario, "drain_ticks", delta_time, "ticks",
+                       ResultsWriter::Better::kLower);
 }
 
-void PrintStateBuffer(const StateEntry* state_entry) {
-  StateEntry last_entry_set = {0};
-  DWORD num_repeats = 0;
-
-  for (auto i = 0; i < kStateBufferEntries; ++i, ++state_entry) {
-    if (i && !memcmp(&last_entry_set, state_entry, sizeof(last_entry_set))) {
-      ++num_repeats;
-      continue;
-    }
-
-    memcpy(&last_entry_set, state_entry, sizeof(last_entry_set));
-    if (num_repeats) {
-      DbgPrint("\t    ... repeated %d times ...\n", num_repeats);
-      num_repeats = 0;
-    }
+// Submits the pushbuffer produced by `build` twice. The first submission is
+// timed without any sampling and the second is traced, so that the cost of
+// sampling does not skew the measured drain time. Returns the drain time of
+// the first submission.
+template <typename BuildFn>
+static uint64_t TimeThenTraceSubmission(BuildFn build, uint32_t num_samples,
+                                        bool* emptied) {
+  NV2A_PROFILE_DECLARE();
+  EmptyCache1();
+  auto p = build();
+  NV2A_PROFILE_START();
+  pb_end(p);
+  *emptied = SpinUntilPushbufferDrained();
+  uint64_t delta_time;
+  NV2A_PROFILE_END(delta_time);
+  pb_reset();
 
-    DbgPrint(
-        "\tDMA: GET 0x%08X PUT 0x%08X  CACHE1: GET 0x%08X PUT 0x%08X "
-        "DmaPush: 0x%08X CachePush0: 0x%08X CachePull0: 0x%08X Cache1Status: "
-        "0x%08X\n",
-        state_entry->dma_get, state_entry->dma_put, state_entry->cache_get,
-        state_entry->cache_put, state_entry->dma_push_state,
-        state_entry->cache1_push0_state, state_entry->cache1_pull0_state,
-        state_entry->cache1_status);
-  }
+  EmptyCache1();
+  p = build();
+  trace_logger->Marker("submit");
+  pb_end(p);
+  trace_logger->SampleWindow(num_samples);
+  SpinUntilPushbufferDrained();
+  trace_logger->Marker("emptied");
+  trace_logger->WaitUntilDrained();
+  pb_reset();
 
-  if (num_repeats) {
-    DbgPrint("\t    ... repeated %d times ...\n", num_repeats);
-  }
+  return delta_time;
 }
 
 void PrintCurrentState() {
-  StateEntry state_entry = {.dma_get = ReadDWORD(DMA_GET_ADDR),
-                            .dma_put = ReadDWORD(DMA_PUT_ADDR),
-                            .cache_get = ReadDWORD(CACHE_GET_ADDR),
-                            .cache_put = ReadDWORD(CACHE_PUT_ADDR),
-                            .dma_push_state = ReadDWORD(CACHE1_DMA_PUSH_STATE),
-                            .cache1_push0_state = ReadDWORD(CACHE1_PUSH0_STATE),
-                            .cache1_pull0_state = ReadDWORD(CACHE1_PULL0_STATE),
-                            .cache1_status = ReadDWORD(CACHE1_STATUS)};
-
-  DbgPrint(
-      "Current state: DMA: GET 0x%08X PUT 0x%08X  CACHE1: GET 0x%08X PUT "
-      "0x%08X "
-      "CachePushState: 0x%08X PullState: 0x%08X cache1status: 0x%08X\n",
-      state_entry.dma_get, state_entry.dma_put, state_entry.cache_get,
-      state_entry.cache_put, state_entry.dma_push_state,
-      state_entry.cache1_pull0_state, state_entry.cache1_status);
-}
+  StateEntry state_entry;
+  CaptureState(&state_entry);
 
-void CommitPushbuffer(uint32_t* p) {
-  pb_Put = p;
-  pb_cache_flush();
-  *USER_DMA_PUT = reinterpret_cast<DWORD>(pb_Put) & 0x03FFFFFF;
-}
-
-inline bool SpinUntilEmptyCache1() {
-  static constexpr auto kMaxLoops = 0x7FFFFFF;
-  auto i = 0;
-  for (; i < kMaxLoops; ++i) {
-    if (ReadDWORD(CACHE1_STATUS) & NV_PFIFO_CACHE1_STATUS_LOW_MARK_EMPTY) {
-      break;
-    }
-    if (ReadDWORD(CACHE_GET_ADDR) == ReadDWORD(CACHE_PUT_ADDR)) {
-      break;
-    }
-  }
-  return i < kMaxLoops;
-}
-
-void EmptyCache1() {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_NO_OPERATION, 1);
-  p = pb_push1(p, NV097_NO_OPERATION, 1);
-  p = pb_push1(p, NV097_NO_OPERATION, 1);
-  p = pb_push1(p, NV097_NO_OPERATION, 1);
-  p = pb_push1(p, NV097_NO_OPERATION, 1);
-  p = pb_push1(p, NV097_NO_OPERATION, 1);
-  p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
-  CommitPushbuffer(p);
-  for (auto i = 0; i < 0x800 && !(ReadDWORD(CACHE1_STATUS) &
-                                  NV_PFIFO_CACHE1_STATUS_LOW_MARK_EMPTY);
-       ++i) {
-    Sleep(1);
-  }
-}
-
-inline void GetNV2ATime(uint64_t* ret) {
-  *ret = ReadDWORD(PTIMER_TIME_HIGH);
-  *ret <<= 32;
-  *ret += ReadDWORD(PTIMER_TIME_LOW);
+  char buffer[kMaxFormattedStateLength];
+  FormatStateEntry(state_entry, buffer, sizeof(buffer));
+  DbgPrint("Current state: %s\n", buffer);
 }
 
 // Prove that neither the DMA pull nor the CACHE1 pointers move until the
@@ -250,8 +115,9 @@ static void TestTinyPushbufferDoesNotAutoKickoff() {
       "At this point the pushbuffer has been created in system memory but "
       "has not been submitted yet. The current DMA and CACHE1 buffer "
       "pointers will now be captured repeatedly and printed.\n");
-  FillStateBuffer(default_state_buffer);
-  PrintStateBuffer(default_state_buffer);
+  trace_logger->Marker("before_commit");
+  trace_logger->SampleWindow(kStateBufferEntries);
+  trace_logger->WaitUntilDrained();
   Sleep(500);
 
   DbgPrint(
@@ -262,14 +128,13 @@ static void TestTinyPushbufferDoesNotAutoKickoff() {
   // This will commit the buffer and cause it to be read.
   // This also enables the CACHE1 to be consumed such that the
   // commands are executed.
+  trace_logger->Marker("commit");
   CommitPushbuffer(p);
-  FillStateBuffer(default_state_buffer);
-
-  DbgPrint("DMA/CACHE1 state immediately following the commit:\n");
-  PrintStateBuffer(default_state_buffer);
+  trace_logger->SampleWindow(kStateBufferEntries);
 
-  DbgPrint("Test completed, sleeping and resetting the pushbuffer pointers\n");
   Sleep(kMillisecondsBetweenTests);
+  trace_logger->WaitUntilDrained();
+  DbgPrint("Test completed, resetting the pushbuffer pointers\n");
   pb_reset();
 }
 
@@ -284,11 +149,6 @@ void TestLoopedBatchingWithoutWaitForIdle() {
   PrintCurrentState();
 
   constexpr auto kNumLoops = 4;
-  StateEntry* state_buffers[kNumLoops];
-  for (auto& buffer : state_buffers) {
-    buffer = new StateEntry[kStateBufferEntries];
-  }
-
   constexpr auto kPushSetsPerLoop = 52;
   constexpr auto kWordsPerSet = 2;
 
@@ -303,27 +163,22 @@ void TestLoopedBatchingWithoutWaitForIdle() {
       p = pb_push1(p, NV097_NO_OPERATION, 0);
     }
 
+    char marker[TraceRecord::kMaxLabelLength];
+    snprintf(marker, sizeof(marker), "submission_%d", loop);
+    trace_logger->Marker(marker);
     pb_end(p);
-    FillStateBuffer(state_buffers[loop]);
+    trace_logger->SampleWindow(kStateBufferEntries);
   }
 
-  for (auto loop = 0; loop < kNumLoops; ++loop) {
-    DbgPrint("DMA/CACHE1 state after submission %d [%d elements = %d bytes]\n",
-             loop, kPushSetsPerLoop * kWordsPerSet,
-             kPushSetsPerLoop * kWordsPerSet * 4);
-    PrintStateBuffer(state_buffers[loop]);
-  }
-
-  for (auto& buffer : state_buffers) {
-    delete[] buffer;
-    buffer = nullptr;
-  }
+  DbgPrint("Each submission is %d elements = %d bytes\n",
+           kPushSetsPerLoop * kWordsPerSet,
+           kPushSetsPerLoop * kWordsPerSet * 4);
 
   Sleep(kMillisecondsBetweenTests);
 
-  DbgPrint("State after final sleep\n");
-  FillStateBuffer(default_state_buffer);
-  PrintStateBuffer(default_state_buffer);
+  trace_logger->Marker("after_final_sleep");
+  trace_logger->SampleWindow(kStateBufferEntries);
+  trace_logger->WaitUntilDrained();
 
   pb_reset();
 }
@@ -339,11 +194,6 @@ void TestLoopedBatchingWithWaitForIdle() {
   PrintCurrentState();
 
   constexpr auto kNumLoops = 4;
-  StateEntry* state_buffers[kNumLoops];
-  for (auto& buffer : state_buffers) {
-    buffer = new StateEntry[kStateBufferEntries];
-  }
-
   constexpr auto kPushSetsPerLoop = 52;
   constexpr auto kWordsPerSet = 2;
 
@@ -358,34 +208,28 @@ void TestLoopedBatchingWithWaitForIdle() {
       p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
     }
 
+    char marker[TraceRecord::kMaxLabelLength];
+    snprintf(marker, sizeof(marker), "submission_%d", loop);
+    trace_logger->Marker(marker);
     pb_end(p);
-    FillStateBuffer(state_buffers[loop]);
-  }
-
-  for (auto loop = 0; loop < kNumLoops; ++loop) {
-    DbgPrint("DMA/CACHE1 state after submission %d [%d elements = %d bytes]\n",
-             loop, kPushSetsPerLoop * kWordsPerSet,
-             kPushSetsPerLoop * kWordsPerSet * 4);
-    PrintStateBuffer(state_buffers[loop]);
+    trace_logger->SampleWindow(kStateBufferEntries);
   }
 
-  for (auto& buffer : state_buffers) {
-    delete[] buffer;
-    buffer = nullptr;
-  }
+  DbgPrint("Each submission is %d elements = %d bytes\n",
+           kPushSetsPerLoop * kWordsPerSet,
+           kPushSetsPerLoop * kWordsPerSet * 4);
 
   Sleep(kMillisecondsBetweenTests);
 
-  DbgPrint("State after final sleep\n");
-  FillStateBuffer(default_state_buffer);
-  PrintStateBuffer(default_state_buffer);
+  trace_logger->Marker("after_final_sleep");
+  trace_logger->SampleWindow(kStateBufferEntries);
+  trace_logger->WaitUntilDrained();
 
   pb_reset();
 }
 
 void TestVeryLargeFlatBufferWithNoWait() {
   DbgPrint("== TestVeryLargeFlatBufferWithNoWait ==\n");
-  NV2A_PROFILE_DECLARE();
 
   DbgPrint(
       "This test submits a very large pushbuffer in one go. WAIT_FOR_IDLE is "
@@ -399,50 +243,36 @@ void TestVeryLargeFlatBufferWithNoWait() {
   constexpr auto kPushSetsPerLoop = 52;
   constexpr auto kWordsPerSet = 2;
 
-  auto p = pb_begin();
-  for (auto loop = 0; loop < kNumLoops; ++loop) {
-    for (auto i = 0; i < kPushSetsPerLoop; ++i) {
-      p = pb_push1(p, NV097_SET_COLOR_CLEAR_VALUE, 0xFFFF0000 + loop * 64);
-      p = pb_push1(p, NV097_CLEAR_SURFACE,
-                   NV097_CLEAR_SURFACE_COLOR | NV097_CLEAR_SURFACE_STENCIL |
-                       NV097_CLEAR_SURFACE_Z);
-      p = pb_push1(p, NV097_NO_OPERATION, 0);
+  auto build = [] {
+    auto p = pb_begin();
+    for (auto loop = 0; loop < kNumLoops; ++loop) {
+      for (auto i = 0; i < kPushSetsPerLoop; ++i) {
+        p = pb_push1(p, NV097_SET_COLOR_CLEAR_VALUE, 0xFFFF0000 + loop * 64);
+        p = pb_push1(p, NV097_CLEAR_SURFACE,
+                     NV097_CLEAR_SURFACE_COLOR | NV097_CLEAR_SURFACE_STENCIL |
+                         NV097_CLEAR_SURFACE_Z);
+        p = pb_push1(p, NV097_NO_OPERATION, 0);
+      }
     }
-  }
-
-  StateEntry* state_buffers[kNumLoops];
-  for (auto& buffer : state_buffers) {
-    buffer = new StateEntry[kStateBufferEntries];
-  }
+    return p;
+  };
 
-  NV2A_PROFILE_START();
-  pb_end(p);
-  for (auto& buffer : state_buffers) {
-    FillStateBuffer(buffer);
-  }
-  bool emptied = SpinUntilEmptyCache1();
-  uint64_t delta_time;
-  NV2A_PROFILE_END(delta_time);
+  bool emptied;
+  auto delta_time = TimeThenTraceSubmission(
+      build, kNumLoops * kStateBufferEntries, &emptied);
 
   DbgPrint("Processed pushbuffer [Emptied:%d] in %" PRIu64 " ticks\n", emptied,
            delta_time);
-
-  for (auto loop = 0; loop < kNumLoops; ++loop) {
-    PrintStateBuffer(state_buffers[loop]);
-  }
-
-  for (auto& buffer : state_buffers) {
-    delete[] buffer;
-    buffer = nullptr;
-  }
+  WriteDrainResults("TestVeryLargeFlatBufferWithNoWait", "default", emptied,
+                    delta_time);
 
   Sleep(kMillisecondsBetweenTests);
+  trace_logger->WaitUntilDrained();
   pb_reset();
 }
 
 void TestVeryLargeFlatBufferWithWaits() {
   DbgPrint("== TestVeryLargeFlatBufferWithWaits ==\n");
-  NV2A_PROFILE_DECLARE();
 
   DbgPrint(
       "This test submits a very large pushbuffer in one go. WAIT_FOR_IDLE is "
@@ -456,43 +286,30 @@ void TestVeryLargeFlatBufferWithWaits() {
   constexpr auto kPushSetsPerLoop = 52;
   constexpr auto kWordsPerSet = 2;
 
-  auto p = pb_begin();
-  for (auto loop = 0; loop < kNumLoops; ++loop) {
-    for (auto i = 0; i < kPushSetsPerLoop; ++i) {
-      p = pb_push1(p, NV097_SET_COLOR_CLEAR_VALUE, 0xFFFF0000 + loop * 64);
-      p = pb_push1(p, NV097_CLEAR_SURFACE,
-                   NV097_CLEAR_SURFACE_COLOR | NV097_CLEAR_SURFACE_STENCIL |
-                       NV097_CLEAR_SURFACE_Z);
-      p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
+  auto build = [] {
+    auto p = pb_begin();
+    for (auto loop = 0; loop < kNumLoops; ++loop) {
+      for (auto i = 0; i < kPushSetsPerLoop; ++i) {
+        p = pb_push1(p, NV097_SET_COLOR_CLEAR_VALUE, 0xFFFF0000 + loop * 64);
+        p = pb_push1(p, NV097_CLEAR_SURFACE,
+                     NV097_CLEAR_SURFACE_COLOR | NV097_CLEAR_SURFACE_STENCIL |
+                         NV097_CLEAR_SURFACE_Z);
+        p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
+      }
     }
-  }
-
-  StateEntry* state_buffers[kNumLoops];
-  for (auto& buffer : state_buffers) {
-    buffer = new StateEntry[kStateBufferEntries];
-  }
+    return p;
+  };
 
-  NV2A_PROFILE_START();
-  pb_end(p);
-  for (auto& buffer : state_buffers) {
-    FillStateBuffer(buffer);
-  }
-  bool emptied = SpinUntilEmptyCache1();
-  uint64_t delta_time;
-  NV2A_PROFILE_END(delta_time);
+  bool emptied;
+  auto delta_time = TimeThenTraceSubmission(
+      build, kNumLoops * kStateBufferEntries, &emptied);
 
   DbgPrint("Processed pushbuffer [Emptied:%d] in %" PRIu64 " ticks\n", emptied,
            delta_time);
-  for (auto loop = 0; loop < kNumLoops; ++loop) {
-    PrintStateBuffer(state_buffers[loop]);
-  }
-
-  for (auto& buffer : state_buffers) {
-    delete[] buffer;
-    buffer = nullptr;
-  }
-
+  WriteDrainResults("TestVeryLargeFlatBufferWithWaits", "default", emptied,
+                    delta_time);
   Sleep(kMillisecondsBetweenTests);
+  trace_logger->WaitUntilDrained();
   pb_reset();
 }
 
@@ -503,36 +320,36 @@ void CompareWaitForIdleAndNopTime() {
       "takes to empty the CACHE1. Then it submits 100 NOP commands and "
       "captures the time it takes to process them.\n");
 
-  auto perform_test = [](uint32_t command) {
-    NV2A_PROFILE_DECLARE();
+  auto perform_test = [](uint32_t command, const char* scenario) {
     EmptyCache1();
     PrintCurrentState();
 
     static constexpr auto kNumEntries = 100;
-    auto p = pb_begin();
-    for (auto i = 0; i < kNumEntries; ++i) {
-      p = pb_push1(p, command, 0);
-    }
-
-    NV2A_PROFILE_START();
-    pb_end(p);
-    FillStateBuffer(default_state_buffer);
-    bool emptied = SpinUntilEmptyCache1();
-    uint64_t delta_time;
-    NV2A_PROFILE_END(delta_time);
-
-    DbgPrint("DMA/CACHE1 state after committing %d entries\n", kNumEntries);
-    PrintStateBuffer(default_state_buffer);
+    auto build = [command] {
+      auto p = pb_begin();
+      for (auto i = 0; i < kNumEntries; ++i) {
+        p = pb_push1(p, command, 0);
+      }
+      return p;
+    };
+
+    bool emptied;
+    auto delta_time =
+        TimeThenTraceSubmission(build, kStateBufferEntries, &emptied);
+
+    DbgPrint("Committed %d entries\n", kNumEntries);
     DbgPrint("Processed pushbuffer [Emptied:%d] in %" PRIu64 " ticks\n",
              emptied, delta_time);
+    WriteDrainResults("CompareWaitForIdleAndNopTime", scenario, emptied,
+                      delta_time);
     pb_reset();
   };
 
   DbgPrint("\tTesting NV097_WAIT_FOR_IDLE\n");
-  perform_test(NV097_WAIT_FOR_IDLE);
+  perform_test(NV097_WAIT_FOR_IDLE, "wait_for_idle");
 
   DbgPrint("\tTesting NV097_NO_OPERATION\n");
-  perform_test(NV097_NO_OPERATION);
+  perform_test(NV097_NO_OPERATION, "nop");
 
   DbgPrint("Test completed, sleeping and resetting the pushbuffer pointers\n");
   Sleep(kMillisecondsBetweenTests);
@@ -547,48 +364,271 @@ void CompareWaitForIdleAndNopTimeWithClears() {
       "NOP + CLEAR_SURFACE pairs and captures the time it takes to process "
       "them.\n");
 
-  auto perform_test = [](uint32_t command) {
-    NV2A_PROFILE_DECLARE();
+  auto perform_test = [](uint32_t command, const char* scenario) {
     EmptyCache1();
     PrintCurrentState();
 
     static constexpr auto kNumEntries = 100;
-    auto p = pb_begin();
-    for (auto i = 0; i < kNumEntries; ++i) {
-      p = pb_push1(p, command, 0);
-      p = pb_push1(p, NV097_CLEAR_SURFACE,
-                   NV097_CLEAR_SURFACE_COLOR | NV097_CLEAR_SURFACE_STENCIL |
-                       NV097_CLEAR_SURFACE_Z);
+    auto build = [command] {
+      auto p = pb_begin();
+      for (auto i = 0; i < kNumEntries; ++i) {
+        p = pb_push1(p, command, 0);
+        p = pb_push1(p, NV097_CLEAR_SURFACE,
+                     NV097_CLEAR_SURFACE_COLOR | NV097_CLEAR_SURFACE_STENCIL |
+                         NV097_CLEAR_SURFACE_Z);
+      }
+      return p;
+    };
+
+    bool emptied;
+    auto delta_time =
+        TimeThenTraceSubmission(build, kStateBufferEntries, &emptied);
+
+    DbgPrint("Committed %d entries\n", kNumEntries);
+    DbgPrint("Processed pushbuffer [Emptied:%d] in %" PRIu64 " ticks\n",
+             emptied, delta_time);
+    WriteDrainResults("CompareWaitForIdleAndNopTimeWithClears", scenario,
+                      emptied, delta_time);
+    pb_reset();
+  };
+
+  DbgPrint("\tTesting NV097_WAIT_FOR_IDLE\n");
+  perform_test(NV097_WAIT_FOR_IDLE, "wait_for_idle");
+
+  DbgPrint("\tTesting NV097_NO_OPERATION\n");
+  perform_test(NV097_NO_OPERATION, "nop");
+
+  DbgPrint("Test completed, sleeping and resetting the pushbuffer pointers\n");
+  Sleep(kMillisecondsBetweenTests);
+  pb_reset();
+}
+
+// pbkit binds its 3D (kelvin) object to subchannel 0. The other two are not
+// used by pbkit.
+static constexpr uint32_t kSwitchSubchannel3D = 0;
+static constexpr uint32_t kSwitchSubchannelKelvin = 5;
+static constexpr uint32_t kSwitchSubchannelBlit = 6;
+static constexpr int kSwitchKelvinChannelID = 30;
+static constexpr int kSwitchBlitChannelID = 31;
+static constexpr int kClassKelvin = 0x97;
+static constexpr int kClassImageBlit = 0x9F;
+
+static constexpr uint32_t kSwitchBenchMethods = 1024;
+static constexpr uint32_t kSwitchBenchRepeats = 4;
+// The final entry places every method in a single run, so there are no
+// switches and it serves as the baseline for the per-switch cost.
+static constexpr uint32_t kSwitchBenchRunLengths[] = {
+    1, 2, 4, 8, 16, 32, 64, 256, kSwitchBenchMethods};
+static constexpr uint32_t kNumSwitchBenchRunLengths =
+    sizeof(kSwitchBenchRunLengths) / sizeof(kSwitchBenchRunLengths[0]);
+// With fewer switches the per-switch cost is dominated by run to run noise,
+// so it is only printed and not recorded as a result.
+static constexpr uint32_t kMinSwitchesForPerSwitchResult = 64;
+
+struct SwitchScenario {
+  const char* name;
+  // If true, every run re-binds `subchannel_a` to alternating objects via
+  // SET_OBJECT (forcing a RAMHT lookup). Otherwise runs alternate between
+  // `subchannel_a` and `subchannel_b`, which stay bound.
+  bool rebind;
+  uint32_t subchannel_a;
+  uint32_t subchannel_b;
+  uint32_t object_a;
+  uint32_t object_b;
+};
+
+// Pushes kSwitchBenchMethods NOPs, switching subchannel (or object) after
+// every `run_length` methods.
+static uint32_t* BuildSwitchingPushbuffer(const SwitchScenario& scenario,
+                                          uint32_t run_length,
+                                          uint32_t* num_switches) {
+  auto p = pb_begin();
+  uint32_t switches = 0;
+  bool use_b = false;
+  for (uint32_t i = 0; i < kSwitchBenchMethods; i += run_length) {
+    if (i) {
+      use_b = !use_b;
+      ++switches;
+    }
+
+    auto subchannel = scenario.subchannel_a;
+    if (scenario.rebind) {
+      p = pb_push1_to(subchannel, p, NV097_SET_OBJECT,
+                      use_b ? scenario.object_b : scenario.object_a);
+    } else if (use_b) {
+      subchannel = scenario.subchannel_b;
     }
 
+    for (uint32_t j = 0; j < run_length && i + j < kSwitchBenchMethods; ++j) {
+      p = pb_push1_to(subchannel, p, NV097_NO_OPERATION, 0);
+    }
+  }
+
+  *num_switches = switches;
+  return p;
+}
+
+// Returns the fastest drain time over kSwitchBenchRepeats submissions.
+static uint64_t MeasureSwitching(const SwitchScenario& scenario,
+                                 uint32_t run_length, uint32_t* num_switches,
+                                 bool* emptied) {
+  uint64_t best = ~0ULL;
+  *emptied = true;
+  for (uint32_t repeat = 0; repeat < kSwitchBenchRepeats; ++repeat) {
+    NV2A_PROFILE_DECLARE();
+    EmptyCache1();
+
+    auto p = BuildSwitchingPushbuffer(scenario, run_length, num_switches);
     NV2A_PROFILE_START();
     pb_end(p);
-    FillStateBuffer(default_state_buffer);
-    bool emptied = SpinUntilEmptyCache1();
+    bool drained = SpinUntilPushbufferDrained();
     uint64_t delta_time;
     NV2A_PROFILE_END(delta_time);
-
-    DbgPrint("DMA/CACHE1 state after committing %d entries\n", kNumEntries);
-    PrintStateBuffer(default_state_buffer);
-    DbgPrint("Processed pushbuffer [Emptied:%d] in %" PRIu64 " ticks\n",
-             emptied, delta_time);
     pb_reset();
+
+    *emptied = *emptied && drained;
+    if (delta_time < best) {
+      best = delta_time;
+    }
+  }
+  return best;
+}
+
+void BenchmarkSubchannelSwitching() {
+  DbgPrint("== BenchmarkSubchannelSwitching ==\n");
+  DbgPrint(
+      "This test submits %d NOPs that alternate between subchannels (or "
+      "objects re-bound via SET_OBJECT) every N methods and measures the "
+      "time to drain them as a function of the switch frequency.\n",
+      kSwitchBenchMethods);
+
+  static constexpr char kTestName[] = "BenchmarkSubchannelSwitching";
+
+  struct s_CtxDma kelvin_ctx;
+  struct s_CtxDma blit_ctx;
+  pb_create_gr_ctx(kSwitchKelvinChannelID, kClassKelvin, &kelvin_ctx);
+  pb_bind_channel(&kelvin_ctx);
+  pb_create_gr_ctx(kSwitchBlitChannelID, kClassImageBlit, &blit_ctx);
+  pb_bind_channel(&blit_ctx);
+
+  const SwitchScenario kScenarios[] = {
+      {"same_class", false, kSwitchSubchannel3D, kSwitchSubchannelKelvin, 0,
+       0},
+      {"cross_class", false, kSwitchSubchannel3D, kSwitchSubchannelBlit, 0,
+       0},
+      {"rebind_same_object", true, kSwitchSubchannelKelvin, 0,
+       kelvin_ctx.ChannelID, kelvin_ctx.ChannelID},
+      {"rebind_cross_class", true, kSwitchSubchannelKelvin, 0,
+       kelvin_ctx.ChannelID, blit_ctx.ChannelID},
   };
 
-  DbgPrint("\tTesting NV097_WAIT_FOR_IDLE\n");
-  perform_test(NV097_WAIT_FOR_IDLE);
+  for (const auto& scenario : kScenarios) {
+    // The rebind scenarios leave kSwitchSubchannelKelvin bound to whichever
+    // object was used last, so restore the bindings before each scenario.
+    EmptyCache1();
+    auto p = pb_begin();
+    p = pb_push1_to(kSwitchSubchannelKelvin, p, NV097_SET_OBJECT,
+                    kelvin_ctx.ChannelID);
+    p = pb_push1_to(kSwitchSubchannelBlit, p, NV097_SET_OBJECT,
+                    blit_ctx.ChannelID);
+    pb_end(p);
+    SpinUntilPushbufferDrained();
+    pb_reset();
 
-  DbgPrint("\tTesting NV097_NO_OPERATION\n");
-  perform_test(NV097_NO_OPERATION);
+    DbgPrint("\tTesting %s\n", scenario.name);
+
+    uint64_t drain_ticks[kNumSwitchBenchRunLengths];
+    uint32_t num_switches[kNumSwitchBenchRunLengths];
+    bool emptied[kNumSwitchBenchRunLengths];
+    for (uint32_t i = 0; i < kNumSwitchBenchRunLengths; ++i) {
+      drain_ticks[i] = MeasureSwitching(scenario, kSwitchBenchRunLengths[i],
+                                        &num_switches[i], &emptied[i]);
+    }
+
+    auto baseline_ticks = drain_ticks[kNumSwitchBenchRunLengths - 1];
+    for (uint32_t i = 0; i < kNumSwitchBenchRunLengths; ++i) {
+      uint64_t ticks_per_switch = 0;
+      if (num_switches[i] && drain_ticks[i] > baseline_ticks) {
+        ticks_per_switch = (drain_ticks[i] - baseline_ticks) / num_switches[i];
+      }
+
+      DbgPrint("\t\trun %4u: switches %4u [Emptied:%d] drain %" PRIu64
+               " ticks, %" PRIu64 " ticks/switch\n",
+               kSwitchBenchRunLengths[i], num_switches[i], emptied[i],
+               drain_ticks[i], ticks_per_switch);
+
+      char result_scenario[64];
+      snprintf(result_scenario, sizeof(result_scenario), "%s_run_%u",
+               scenario.name, kSwitchBenchRunLengths[i]);
+      WriteDrainResults(kTestName, result_scenario, emptied[i],
+                        drain_ticks[i]);
+      // A drain no slower than the baseline leaves nothing to attribute to the
+      // switches, so the clamped 0 is not recorded either.
+      if (num_switches[i] >= kMinSwitchesForPerSwitchResult &&
+          ticks_per_switch) {
+        results->WriteMetric(kTestName, result_scenario, "ticks_per_switch",
+                             ticks_per_switch, "ticks",
+                             ResultsWriter::Better::kLower);
+      }
+    }
+
+    // Capture a trace of the most frequent switching so CTX_SWITCH1/RAMHT
+    // activity can be compared across systems. This is done separately from
+    // the timed runs so that sampling does not skew the measurements.
+    uint32_t unused_switches;
+    EmptyCache1();
+    p = BuildSwitchingPushbuffer(scenario, kSwitchBenchRunLengths[0],
+                                 &unused_switches);
+    trace_logger->Marker(scenario.name);
+    pb_end(p);
+    trace_logger->SampleWindow(kStateBufferEntries);
+    SpinUntilPushbufferDrained();
+    pb_reset();
+    trace_logger->WaitUntilDrained();
+  }
 
   DbgPrint("Test completed, sleeping and resetting the pushbuffer pointers\n");
   Sleep(kMillisecondsBetweenTests);
   pb_reset();
 }
 
-int main() {
-  default_state_buffer = new StateEntry[kStateBufferEntries];
+#ifdef ENABLE_PFIFO_SOAK
+static void RunSoak() {
+  DbgPrint("== PfifoSoak ==\n");
+  DbgPrint(
+      "This test repeatedly submits a random mix of NOP/WAIT_FOR_IDLE batches "
+      "(optionally interleaved with clears) for %d seconds, reporting rolling "
+      "drain throughput and capturing the DMA/CACHE1 state around hangs and "
+      "throughput regressions.\n",
+      PFIFO_SOAK_DURATION_SECONDS);
+
+  // The mix and thresholds are set via the PFIFO_SOAK_* CMake cache variables.
+  static constexpr SoakWorkload kWorkloads[] = {
+      {"nop", PFIFO_SOAK_WEIGHT_NOP, NV097_NO_OPERATION, false},
+      {"wfi", PFIFO_SOAK_WEIGHT_WFI, NV097_WAIT_FOR_IDLE, false},
+      {"nop_clear", PFIFO_SOAK_WEIGHT_NOP_CLEAR, NV097_NO_OPERATION, true},
+      {"wfi_clear", PFIFO_SOAK_WEIGHT_WFI_CLEAR, NV097_WAIT_FOR_IDLE, true},
+  };
+
+  SoakConfig config{
+      .duration_ms = PFIFO_SOAK_DURATION_SECONDS * 1000,
+      .report_interval_ms = 10000,
+      .sets_per_batch = PFIFO_SOAK_SETS_PER_BATCH,
+      // PTIMER nominally counts nanoseconds.
+      .drain_deadline_ticks = PFIFO_SOAK_DRAIN_DEADLINE_MS * 1000000ULL,
+      .rolling_window = PFIFO_SOAK_ROLLING_WINDOW,
+      .degradation_percent = PFIFO_SOAK_DEGRADATION_PERCENT,
+      .seed = PFIFO_SOAK_SEED,
+      .workloads = kWorkloads,
+      .num_workloads = sizeof(kWorkloads) / sizeof(kWorkloads[0]),
+  };
 
+  RunPfifoSoak(config, trace_logger, results);
+  pb_reset();
+}
+#endif  // ENABLE_PFIFO_SOAK
+
+int main() {
   debugPrint("Set video mode");
   if (!XVideoSetMode(kFramebufferWidth, kFramebufferHeight, kBitsPerPixel,
                      REFRESH_DEFAULT)) {
@@ -619,6 +659,30 @@ int main() {
   pb_show_front_screen();
   debugClearScreen();
 
+  DbgPrintTraceSink trace_sink;
+  trace_logger = new TraceLogger(&trace_sink);
+  if (!trace_logger->Start()) {
+    debugPrint("Failed to start trace drain thread\n");
+    Sleep(2000);
+    return 1;
+  }
+
+  FILE* results_file = nullptr;
+#ifdef PFIFO_WRITE_RESULTS_FILE
+  static constexpr char kResultsFilePath[] = "E:\\pfifo_cache1_results.jsonl";
+  if (!nxIsDriveMounted('E') &&
+      !nxMountDrive('E', "\\Device\\Harddisk0\\Partition1\\")) {
+    debugPrint("Failed to mount E: for the results file\n");
+  } else {
+    results_file = fopen(kResultsFilePath, "w");
+    if (!results_file) {
+      debugPrint("Failed to open %s\n", kResultsFilePath);
+    }
+  }
+#endif
+  results = new ResultsWriter(results_file);
+  results->WriteRunInfo("pfifo_cache1_test", PFIFO_RESULTS_PLATFORM);
+
   // Target the front buffer so all rendering is immediately visible without
   // dealing with flip/stall/etc...
   set_draw_buffer(pb_FBAddr[pb_front_index] & 0x03FFFFFF);
@@ -633,6 +697,22 @@ int main() {
   CompareWaitForIdleAndNopTime();
   CompareWaitForIdleAndNopTimeWithClears();
 
+  BenchmarkSubchannelSwitching();
+
+#ifdef ENABLE_PFIFO_SOAK
+  RunSoak();
+#endif
+
+  trace_logger->Stop();
+  delete trace_logger;
+  trace_logger = nullptr;
+
+  delete results;
+  results = nullptr;
+  if (results_file) {
+    fclose(results_file);
+  }
+
   pb_kill();
   return 0;
 }
@@ -0,0 +1,317 @@
+#include "pfifo_soak.h"
+
+#include <hal/debug.h>
+#include <pbkit/pbkit.h>
+
+#include <cinttypes>
+#include <cstdio>
+
+#include "nv2a_pfifo.h"
+#include "results_writer.h"
+#include "trace_logger.h"
+
+static constexpr uint32_t kMaxRollingWindow = 256;
+static constexpr uint32_t kPostAnomalySamples = 4096;
+// PTIMER is only read every this many polls while waiting for a batch to
+// drain, so the deadline check adds little to the measured drain time.
+static constexpr uint32_t kPollsPerDeadlineCheck = 64;
+
+struct WorkloadStats {
+  // Drain ticks of the most recent `rolling_window` batches.
+  uint64_t window[kMaxRollingWindow];
+  uint32_t window_count;
+  uint32_t window_next;
+  uint64_t window_sum;
+
+  // Sum of the first full window; 0 until that window has been filled.
+  uint64_t baseline_sum;
+  bool degraded;
+
+  uint32_t interval_batches;
+  uint64_t interval_words;
+  uint64_t interval_ticks;
+  uint64_t interval_max_ticks;
+
+  uint64_t total_batches;
+  uint64_t total_words;
+  uint64_t total_ticks;
+};
+
+static uint32_t NextRandom(uint32_t* state) {
+  auto x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+static uint32_t PickWorkload(const SoakConfig& config, uint32_t total_weight,
+                             uint32_t* rng_state) {
+  auto choice = NextRandom(rng_state) % total_weight;
+  for (uint32_t i = 0; i < config.num_workloads; ++i) {
+    auto weight = config.workloads[i].weight;
+    if (choice < weight) {
+      return i;
+    }
+    choice -= weight;
+  }
+  return config.num_workloads - 1;
+}
+
+static uint32_t* BuildBatch(const SoakWorkload& workload, uint32_t num_sets,
+                            uint32_t* num_words) {
+  auto p = pb_begin();
+  for (uint32_t i = 0; i < num_sets; ++i) {
+    p = pb_push1(p, workload.command, 0);
+    if (workload.with_clear) {
+      p = pb_push1(p, NV097_CLEAR_SURFACE,
+                   NV097_CLEAR_SURFACE_COLOR | NV097_CLEAR_SURFACE_STENCIL |
+                       NV097_CLEAR_SURFACE_Z);
+    }
+  }
+  *num_words = num_sets * (workload.with_clear ? 4 : 2);
+  return p;
+}
+
+// Polls for the pushbuffer to drain without any tracing so that the returned
+// `end_time` reflects only the pusher/puller throughput.
+static bool WaitForDrain(uint64_t start_time, uint64_t deadline_ticks,
+                         uint64_t* end_time) {
+  for (uint32_t polls = 1;; ++polls) {
+    if (IsPushbufferDrained()) {
+      GetNV2ATime(end_time);
+      return true;
+    }
+    if (!(polls % kPollsPerDeadlineCheck)) {
+      GetNV2ATime(end_time);
+      if (*end_time - start_time > deadline_ticks) {
+        return false;
+      }
+    }
+  }
+}
+
+// Records a batch and returns true if the workload has just crossed the
+// degradation threshold.
+static bool UpdateStats(WorkloadStats* stats, uint64_t drain_ticks,
+                        uint32_t num_words, const SoakConfig& config) {
+  ++stats->interval_batches;
+  stats->interval_words += num_words;
+  stats->interval_ticks += drain_ticks;
+  if (drain_ticks > stats->interval_max_ticks) {
+    stats->interval_max_ticks = drain_ticks;
+  }
+
+  ++stats->total_batches;
+  stats->total_words += num_words;
+  stats->total_ticks += drain_ticks;
+
+  if (stats->window_count == config.rolling_window) {
+    stats->window_sum -= stats->window[stats->window_next];
+  } else {
+    ++stats->window_count;
+  }
+  stats->window[stats->window_next] = drain_ticks;
+  stats->window_sum += drain_ticks;
+  stats->window_next = (stats->window_next + 1) % config.rolling_window;
+
+  if (stats->window_count < config.rolling_window) {
+    return false;
+  }
+
+  if (!stats->baseline_sum) {
+    stats->baseline_sum = stats->window_sum;
+    return false;
+  }
+
+  bool degraded = stats->window_sum * 100 >
+                  stats->baseline_sum * (100 + config.degradation_percent);
+  bool newly_degraded = degraded && !stats->degraded;
+  stats->degraded = degraded;
+  return newly_degraded;
+}
+
+// Writes the flight recorder contents followed by a marker for the anomaly to
+// the trace.
+static void RecordAnomaly(const char* kind, uint64_t batch,
+                          TraceHistory* history, TraceLogger* trace_logger) {
+  char label[TraceRecord::kMaxLabelLength];
+  snprintf(label, sizeof(label), "%s_%" PRIu64, kind, batch);
+  DbgPrint("Soak anomaly %s\n", label);
+
+  history->DumpTo(trace_logger);
+  trace_logger->Marker(label);
+}
+
+// Resubmits a batch of `workload` while sampling into the trace. Used to
+// capture a throughput regression without slowing down the timed batches.
+static void TraceBatch(const SoakWorkload& workload, const SoakConfig& config,
+                       TraceLogger* trace_logger) {
+  uint32_t num_words;
+  auto p = BuildBatch(workload, config.sets_per_batch, &num_words);
+  pb_end(p);
+  trace_logger->SampleWindow(kPostAnomalySamples);
+  SpinUntilPushbufferDrained();
+  pb_reset();
+}
+
+static void ReportStats(const SoakConfig& config, WorkloadStats* stats,
+                        DWORD elapsed_ms) {
+  for (uint32_t i = 0; i < config.num_workloads; ++i) {
+    auto& workload_stats = stats[i];
+    if (!workload_stats.interval_batches) {
+      continue;
+    }
+
+    auto rolling_mean = workload_stats.window_sum / workload_stats.window_count;
+    auto baseline_mean = workload_stats.baseline_sum / config.rolling_window;
+    DbgPrint(
+        "Soak [%lu s] %s: batches %u mean drain %" PRIu64 " max %" PRIu64
+        " ticks, %" PRIu64 " words/Mtick, rolling %" PRIu64
+        " baseline %" PRIu64 "%s\n",
+        elapsed_ms / 1000, config.workloads[i].name,
+        workload_stats.interval_batches,
+        workload_stats.interval_ticks / workload_stats.interval_batches,
+        workload_stats.interval_max_ticks,
+        workload_stats.interval_ticks ? workload_stats.interval_words *
+                                            1000000 /
+                                            workload_stats.interval_ticks
+                                      : 0,
+        rolling_mean, baseline_mean,
+        workload_stats.degraded ? " DEGRADED" : "");
+
+    workload_stats.interval_batches = 0;
+    workload_stats.interval_words = 0;
+    workload_stats.interval_ticks = 0;
+    workload_stats.interval_max_ticks = 0;
+  }
+}
+
+static constexpr char kResultsTestName[] = "PfifoSoak";
+
+bool RunPfifoSoak(const SoakConfig& config, TraceLogger* trace_logger,
+                  ResultsWriter* results) {
+  if (!config.num_workloads || !config.rolling_window ||
+      config.rolling_window > kMaxRollingWindow) {
+    DbgPrint("Invalid soak configuration\n");
+    return false;
+  }
+
+  uint32_t total_weight = 0;
+  for (uint32_t i = 0; i < config.num_workloads; ++i) {
+    total_weight += config.workloads[i].weight;
+  }
+  if (!total_weight) {
+    DbgPrint("Invalid soak configuration: all workload weights are 0\n");
+    return false;
+  }
+
+  auto stats = new WorkloadStats[config.num_workloads]();
+  auto history = new TraceHistory();
+  uint32_t rng_state = config.seed ? config.seed : 1;
+
+  uint64_t batch = 0;
+  uint32_t num_hangs = 0;
+  uint32_t num_degradations = 0;
+  bool aborted = false;
+
+  EmptyCache1();
+  pb_reset();
+  trace_logger->Marker("soak_start");
+
+  auto start_ms = GetTickCount();
+  auto last_report_ms = start_ms;
+  while (GetTickCount() - start_ms < config.duration_ms) {
+    auto workload_index = PickWorkload(config, total_weight, &rng_state);
+    const auto& workload = config.workloads[workload_index];
+
+    uint32_t num_words;
+    auto p = BuildBatch(workload, config.sets_per_batch, &num_words);
+
+    uint64_t start_time;
+    uint64_t end_time;
+    pb_end(p);
+    // A single sample per batch, taken while the batch is in flight and
+    // before the timed region, so the history shows the DMA GET progress and
+    // pusher/puller state of the batches leading up to an anomaly.
+    history->Sample();
+    GetNV2ATime(&start_time);
+    bool drained =
+        WaitForDrain(start_time, config.drain_deadline_ticks, &end_time);
+    ++batch;
+
+    if (!drained) {
+      ++num_hangs;
+      RecordAnomaly("hang", batch, history, trace_logger);
+      trace_logger->SampleWindow(kPostAnomalySamples);
+
+      EmptyCache1();
+      if (!IsPushbufferDrained()) {
+        DbgPrint("Soak: pushbuffer did not recover after hang, aborting\n");
+        aborted = true;
+        break;
+      }
+      pb_reset();
+      continue;
+    }
+    pb_reset();
+
+    if (UpdateStats(&stats[workload_index], end_time - start_time, num_words,
+                    config)) {
+      ++num_degradations;
+      char kind[TraceRecord::kMaxLabelLength];
+      snprintf(kind, sizeof(kind), "slow_%s", workload.name);
+      RecordAnomaly(kind, batch, history, trace_logger);
+      TraceBatch(workload, config, trace_logger);
+    }
+
+    auto now_ms = GetTickCount();
+    if (now_ms - last_report_ms >= config.report_interval_ms) {
+      ReportStats(config, stats, now_ms - start_ms);
+      trace_logger->WaitUntilDrained();
+      last_report_ms = now_ms;
+    }
+  }
+
+  trace_logger->Marker("soak_end");
+  trace_logger->WaitUntilDrained();
+
+  auto elapsed_ms = GetTickCount() - start_ms;
+  ReportStats(config, stats, elapsed_ms);
+  for (uint32_t i = 0; i < config.num_workloads; ++i) {
+    auto& workload_stats = stats[i];
+    if (!workload_stats.total_batches) {
+      continue;
+    }
+    DbgPrint("Soak total %s: batches %" PRIu64 " words %" PRIu64
+             " mean drain %" PRIu64 " ticks\n",
+             config.workloads[i].name, workload_stats.total_batches,
+             workload_stats.total_words,
+             workload_stats.total_ticks / workload_stats.total_batches);
+
+    results->WriteMetric(
+        kResultsTestName, config.workloads[i].name, "mean_drain_ticks",
+        workload_stats.total_ticks / workload_stats.total_batches, "ticks",
+        ResultsWriter::Better::kLower);
+    if (workload_stats.total_ticks) {
+      results->WriteMetric(
+          kResultsTestName, config.workloads[i].name, "words_per_mtick",
+          workload_stats.total_words * 1000000 / workload_stats.total_ticks,
+          "words/Mtick", ResultsWriter::Better::kHigher);
+    }
+  }
+  DbgPrint("Soak finished after %lu ms: batches %" PRIu64
+           " hangs %u degradations %u dropped trace records %u%s\n",
+           elapsed_ms, batch, num_hangs, num_degradations,
+           trace_logger->dropped(), aborted ? " ABORTED" : "");
+  results->WriteMetric(kResultsTestName, "all", "hangs", num_hangs, "count",
+                       ResultsWriter::Better::kLower);
+  results->WriteMetric(kResultsTestName, "all", "degradations",
+                       num_degradations, "count",
+                       ResultsWriter::Better::kLower);
+
+  delete history;
+  delete[] stats;
+  return !aborted;
+}
@@ -0,0 +1,60 @@
+#ifndef PFIFO_SOAK_H_
+#define PFIFO_SOAK_H_
+
+#include <windows.h>
+
+#include <cstdint>
+
+class ResultsWriter;
+class TraceLogger;
+
+// One kind of batch that the soak may submit.
+struct SoakWorkload {
+  const char* name;
+  // Relative likelihood of this workload being chosen for a batch.
+  uint32_t weight;
+  // Method pushed once per set (e.g., NV097_NO_OPERATION).
+  uint32_t command;
+  // If true, each set is followed by a CLEAR_SURFACE.
+  bool with_clear;
+};
+
+struct SoakConfig {
+  // Total wall clock duration of the soak.
+  DWORD duration_ms;
+  // How often rolling statistics are reported.
+  DWORD report_interval_ms;
+
+  // Number of sets pushed in each batch.
+  uint32_t sets_per_batch;
+
+  // Batches that fail to drain CACHE1 within this many PTIMER ticks are
+  // treated as hangs.
+  uint64_t drain_deadline_ticks;
+
+  // Number of batches per workload averaged for the rolling throughput. The
+  // first full window of each workload becomes its baseline.
+  uint32_t rolling_window;
+  // A rolling average this many percent slower than the baseline is reported
+  // as a throughput degradation.
+  uint32_t degradation_percent;
+
+  // Seed for the workload selection PRNG so runs are reproducible.
+  uint32_t seed;
+
+  const SoakWorkload* workloads;
+  uint32_t num_workloads;
+};
+
+// Repeatedly submits batches drawn from `config.workloads` until the duration
+// elapses or an unrecoverable hang is detected. Batches are timed without
+// tracing. When an anomaly is detected, a sample of each recent batch taken
+// just after submission is written to `trace_logger`. That is followed by a
+// trace of the hung state or of a resubmitted batch of the slowed down
+// workload. Final per-workload statistics are written to `results`.
+//
+// Returns false if the soak was aborted due to a hang.
+bool RunPfifoSoak(const SoakConfig& config, TraceLogger* trace_logger,
+                  ResultsWriter* results);
+
+#endif  // PFIFO_SOAK_H_
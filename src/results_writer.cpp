@@ -0,0 +1,67 @@
+#include "results_writer.h"
+
+#include <hal/debug.h>
+#include <xboxkrnl/xboxkrnl.h>
+
+#include <cinttypes>
+
+#include "nv2a_pfifo.h"
+
+static constexpr size_t kMaxLineLength = 512;
+static constexpr size_t kMaxPlatformLabelLength = 128;
+
+// Copies `value` into `buffer`, escaping the characters that may not appear
+// unescaped in a JSON string. The result is truncated to fit `size`.
+static void EscapeJsonString(const char* value, char* buffer, size_t size) {
+  size_t offset = 0;
+  // Leave room for the longest escape sequence ("\u00XX") and the terminator.
+  for (; *value && offset + 7 < size; ++value) {
+    auto c = static_cast<unsigned char>(*value);
+    if (c == '"' || c == '\\') {
+      buffer[offset++] = '\\';
+      buffer[offset++] = static_cast<char>(c);
+    } else if (c < 0x20) {
+      offset += snprintf(buffer + offset, size - offset, "\\u%04x", c);
+    } else {
+      buffer[offset++] = static_cast<char>(c);
+    }
+  }
+  buffer[offset] = 0;
+}
+
+void ResultsWriter::WriteRunInfo(const char* test_suite,
+                                 const char* platform_label) {
+  char escaped_platform[kMaxPlatformLabelLength];
+  EscapeJsonString(platform_label, escaped_platform, sizeof(escaped_platform));
+
+  char line[kMaxLineLength];
+  snprintf(line, sizeof(line),
+           "{\"type\":\"run\",\"schema\":%u,\"suite\":\"%s\","
+           "\"platform\":\"%s\",\"pmc_boot_0\":\"0x%08X\","
+           "\"kernel\":\"%u.%u.%u.%u\"}",
+           kSchemaVersion, test_suite, escaped_platform, ReadDWORD(PMC_BOOT_0),
+           XboxKrnlVersion.Major, XboxKrnlVersion.Minor, XboxKrnlVersion.Build,
+           XboxKrnlVersion.Qfe);
+  WriteLine(line);
+}
+
+void ResultsWriter::WriteMetric(const char* test, const char* scenario,
+                                const char* metric, uint64_t value,
+                                const char* unit, Better better) {
+  char line[kMaxLineLength];
+  snprintf(line, sizeof(line),
+           "{\"type\":\"metric\",\"test\":\"%s\",\"scenario\":\"%s\","
+           "\"metric\":\"%s\",\"value\":%" PRIu64
+           ",\"unit\":\"%s\",\"better\":\"%s\"}",
+           test, scenario, metric, value, unit,
+           better == Better::kLower ? "lower" : "higher");
+  WriteLine(line);
+}
+
+void ResultsWriter::WriteLine(const char* line) {
+  DbgPrint("RESULT %s\n", line);
+  if (file_) {
+    fprintf(file_, "%s\n", line);
+    fflush(file_);
+  }
+}
@@ -0,0 +1,40 @@
+#ifndef RESULTS_WRITER_H_
+#define RESULTS_WRITER_H_
+
+#include <cstdint>
+#include <cstdio>
+
+// Emits machine readable benchmark results as JSON lines that can be compared
+// between runs with compare_results.py.
+//
+// Every line is sent to DbgPrint prefixed with "RESULT " so results can be
+// recovered from a debug log, and is additionally written to `file` if one is
+// provided.
+class ResultsWriter {
+ public:
+  // Bump whenever the meaning of existing fields changes.
+  static constexpr uint32_t kSchemaVersion = 1;
+
+  enum class Better {
+    kLower,
+    kHigher,
+  };
+
+  // `file` is not owned and may be nullptr.
+  explicit ResultsWriter(FILE* file) : file_(file) {}
+
+  // Records the identity of the hardware/emulator the results were gathered
+  // on. `platform_label` is a free form, user provided description (e.g.,
+  // "xemu 0.8.x" or "1.0 retail").
+  void WriteRunInfo(const char* test_suite, const char* platform_label);
+
+  void WriteMetric(const char* test, const char* scenario, const char* metric,
+                   uint64_t value, const char* unit, Better better);
+
+ private:
+  void WriteLine(const char* line);
+
+  FILE* file_;
+};
+
+#endif  // RESULTS_WRITER_H_
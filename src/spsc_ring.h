@@ -0,0 +1,60 @@
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <atomic>
+#include <cstdint>
+
+// Fixed capacity, lock-free, single-producer/single-consumer ring buffer.
+//
+// Exactly one thread may call TryPush and exactly one (other) thread may call
+// TryPop. Indices run freely and are masked on access, so kCapacity must be a
+// power of two.
+template <typename T, uint32_t kCapacity>
+class SPSCRing {
+  static_assert(kCapacity && !(kCapacity & (kCapacity - 1)),
+                "kCapacity must be a power of two");
+
+ public:
+  static constexpr uint32_t kMask = kCapacity - 1;
+
+  // Producer only. Returns false if the ring is full.
+  bool TryPush(const T& item) {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == kCapacity) {
+      return false;
+    }
+    buffer_[head & kMask] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. Returns false if the ring is empty.
+  bool TryPop(T* item) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *item = buffer_[tail & kMask];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Producer only. Number of items that have not been popped yet; may
+  // overestimate while the consumer is popping.
+  [[nodiscard]] uint32_t Size() const {
+    return head_.load(std::memory_order_relaxed) -
+           tail_.load(std::memory_order_acquire);
+  }
+
+  [[nodiscard]] bool Empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+ private:
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  T buffer_[kCapacity];
+};
+
+#endif  // SPSC_RING_H_
@@ -0,0 +1,237 @@
+#include "trace_logger.h"
+
+#include <hal/debug.h>
+
+#include <cinttypes>
+#include <cstring>
+
+static constexpr size_t kMaxLineLength = kMaxFormattedStateLength + 64;
+
+void DbgPrintTraceSink::WriteLine(const char* line) { DbgPrint("%s", line); }
+
+void FileTraceSink::WriteLine(const char* line) { fputs(line, file_); }
+
+void FileTraceSink::Flush() { fflush(file_); }
+
+TraceLogger::~TraceLogger() { Stop(); }
+
+bool TraceLogger::Start() {
+  if (thread_) {
+    return true;
+  }
+
+  stop_requested_.store(false, std::memory_order_relaxed);
+  thread_ = CreateThread(nullptr, 0, DrainThreadProc, this, 0, nullptr);
+  if (!thread_) {
+    return false;
+  }
+
+  // Keep the drain out of the way of the sampling loop; it should only run
+  // when the producer is idle.
+  SetThreadPriority(thread_, THREAD_PRIORITY_LOWEST);
+  return true;
+}
+
+void TraceLogger::Stop() {
+  if (!thread_) {
+    return;
+  }
+
+  WaitUntilDrained();
+  stop_requested_.store(true, std::memory_order_release);
+  WaitForSingleObject(thread_, INFINITE);
+  CloseHandle(thread_);
+  thread_ = nullptr;
+}
+
+void TraceLogger::Marker(const char* label) {
+  FlushPending();
+
+  TraceRecord record{};
+  GetNV2ATime(&record.timestamp);
+  record.type = TraceRecord::Type::kMarker;
+  strncpy(record.label, label, TraceRecord::kMaxLabelLength - 1);
+  Push(record);
+}
+
+void TraceLogger::Sample() {
+  StateEntry state;
+  CaptureState(&state);
+
+  if (has_pending_ && !memcmp(&pending_.state, &state, sizeof(state))) {
+    ++pending_.repeats;
+    return;
+  }
+
+  FlushPending();
+
+  // The timestamp is only needed when the state changes, so it is read after
+  // the registers to keep the common (repeated) path short.
+  GetNV2ATime(&pending_.timestamp);
+  pending_.repeats = 0;
+  pending_.type = TraceRecord::Type::kState;
+  pending_.state = state;
+  has_pending_ = true;
+}
+
+void TraceLogger::SampleWindow(uint32_t num_samples) {
+  for (uint32_t i = 0; i < num_samples; ++i) {
+    Sample();
+  }
+  FlushPending();
+}
+
+void TraceLogger::Append(const TraceRecord& record) {
+  FlushPending();
+  Push(record);
+}
+
+void TraceLogger::FlushPending() {
+  if (!has_pending_) {
+    return;
+  }
+  Push(pending_);
+  has_pending_ = false;
+}
+
+void TraceLogger::WaitUntilDrained() {
+  FlushPending();
+  if (!thread_) {
+    return;
+  }
+
+  while (!FlushDropNotice()) {
+    Sleep(1);
+  }
+
+  auto target = pushed_.load(std::memory_order_relaxed);
+  while (emitted_.load(std::memory_order_acquire) != target) {
+    Sleep(1);
+  }
+  sink_->Flush();
+}
+
+void TraceLogger::Push(const TraceRecord& record) {
+  auto limit = record.type == TraceRecord::Type::kState
+                   ? kCapacity - kMarkerReserve
+                   : kCapacity;
+  // Outstanding drops are reported immediately ahead of the next record that
+  // fits, so the notice needs a slot of its own.
+  auto needed = drop_notice_.repeats ? 2 : 1;
+  if (ring_.Size() + needed > limit || !FlushDropNotice() ||
+      !ring_.TryPush(record)) {
+    if (!drop_notice_.repeats) {
+      drop_notice_.timestamp = record.timestamp;
+      drop_notice_.type = TraceRecord::Type::kDropped;
+    }
+    ++drop_notice_.repeats;
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  pushed_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool TraceLogger::FlushDropNotice() {
+  if (!drop_notice_.repeats) {
+    return true;
+  }
+  if (!ring_.TryPush(drop_notice_)) {
+    return false;
+  }
+  pushed_.fetch_add(1, std::memory_order_relaxed);
+  drop_notice_.repeats = 0;
+  return true;
+}
+
+DWORD WINAPI TraceLogger::DrainThreadProc(LPVOID param) {
+  reinterpret_cast<TraceLogger*>(param)->DrainLoop();
+  return 0;
+}
+
+void TraceLogger::DrainLoop() {
+  TraceRecord record;
+  while (true) {
+    auto drained_any = false;
+    while (ring_.TryPop(&record)) {
+      Emit(record);
+      emitted_.fetch_add(1, std::memory_order_release);
+      drained_any = true;
+    }
+
+    if (drained_any) {
+      continue;
+    }
+
+    if (stop_requested_.load(std::memory_order_acquire) && ring_.Empty()) {
+      break;
+    }
+    Sleep(1);
+  }
+
+  sink_->Flush();
+}
+
+void TraceLogger::Emit(const TraceRecord& record) {
+  char line[kMaxLineLength];
+
+  if (record.type == TraceRecord::Type::kMarker) {
+    snprintf(line, sizeof(line), "\t@%" PRIu64 " MARK %s\n", record.timestamp,
+             record.label);
+    sink_->WriteLine(line);
+    return;
+  }
+
+  if (record.type == TraceRecord::Type::kDropped) {
+    snprintf(line, sizeof(line),
+             "\t    ... dropped %u records starting @%" PRIu64 " ...\n",
+             record.repeats, record.timestamp);
+    sink_->WriteLine(line);
+    return;
+  }
+
+  auto prefix_length = snprintf(line, sizeof(line), "\t@%" PRIu64 " ",
+                                record.timestamp);
+  FormatStateEntry(record.state, line + prefix_length,
+                   sizeof(line) - prefix_length - 1);
+  strcat(line, "\n");
+  sink_->WriteLine(line);
+
+  if (record.repeats) {
+    snprintf(line, sizeof(line), "\t    ... repeated %u times ...\n",
+             record.repeats);
+    sink_->WriteLine(line);
+  }
+}
+
+void TraceHistory::Sample() {
+  StateEntry state;
+  CaptureState(&state);
+
+  if (count_) {
+    auto& last = records_[(next_ - 1) & (kCapacity - 1)];
+    if (!memcmp(&last.state, &state, sizeof(state))) {
+      ++last.repeats;
+      return;
+    }
+  }
+
+  auto& record = records_[next_];
+  GetNV2ATime(&record.timestamp);
+  record.repeats = 0;
+  record.type = TraceRecord::Type::kState;
+  record.state = state;
+
+  next_ = (next_ + 1) & (kCapacity - 1);
+  if (count_ < kCapacity) {
+    ++count_;
+  }
+}
+
+void TraceHistory::DumpTo(TraceLogger* logger) {
+  auto index = (next_ - count_) & (kCapacity - 1);
+  for (uint32_t i = 0; i < count_; ++i) {
+    logger->Append(records_[index]);
+    index = (index + 1) & (kCapacity - 1);
+  }
+  count_ = 0;
+}
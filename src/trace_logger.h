@@ -0,0 +1,154 @@
+#ifndef TRACE_LOGGER_H_
+#define TRACE_LOGGER_H_
+
+#include <windows.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+#include "nv2a_pfifo.h"
+#include "spsc_ring.h"
+#include "trace_registers.h"
+
+// Single entry in the trace ring. State samples are coalesced by the producer
+// so a record covers `repeats + 1` identical consecutive samples.
+struct TraceRecord {
+  static constexpr uint32_t kMaxLabelLength = 32;
+
+  enum class Type : uint8_t {
+    kState,
+    kMarker,
+    // Placeholder for records that were discarded because the ring was full.
+    // `timestamp` is that of the first discarded record and `repeats` is the
+    // number of records discarded.
+    kDropped,
+  };
+
+  // PTIMER value at the time the record was captured.
+  uint64_t timestamp;
+  // Number of additional identical samples folded into this record.
+  uint32_t repeats;
+  Type type;
+  union {
+    StateEntry state;
+    char label[kMaxLabelLength];
+  };
+};
+
+// Destination for formatted trace lines. Called only from the drain thread.
+class TraceSink {
+ public:
+  virtual ~TraceSink() = default;
+  virtual void WriteLine(const char* line) = 0;
+  virtual void Flush() {}
+};
+
+class DbgPrintTraceSink : public TraceSink {
+ public:
+  void WriteLine(const char* line) override;
+};
+
+// Appends trace lines to an already opened file. The file is not owned.
+class FileTraceSink : public TraceSink {
+ public:
+  explicit FileTraceSink(FILE* file) : file_(file) {}
+
+  void WriteLine(const char* line) override;
+  void Flush() override;
+
+ private:
+  FILE* file_;
+};
+
+// Collects DMA/CACHE1 state samples into a lock-free ring that is emptied into
+// a TraceSink by a low priority background thread.
+//
+// All methods other than dropped() must be called from the single producer
+// thread. The Xbox has a single core, so the drain thread only makes progress
+// while the producer is blocked (e.g., in Sleep or WaitUntilDrained).
+//
+// State records may not use the last kMarkerReserve entries of the ring, so
+// phase markers survive a sampling window that overflows the ring. Discarded
+// records are replaced by a single kDropped record at the point they were lost.
+class TraceLogger {
+ public:
+  static constexpr uint32_t kCapacity = 16384;
+  static constexpr uint32_t kMarkerReserve = 64;
+
+  explicit TraceLogger(TraceSink* sink) : sink_(sink) {}
+  ~TraceLogger();
+
+  // Starts the drain thread. Returns false if the thread could not be created.
+  bool Start();
+  // Emits all outstanding records and joins the drain thread.
+  void Stop();
+
+  // Inserts a named phase marker into the trace.
+  void Marker(const char* label);
+
+  // Captures the current DMA/CACHE1 state.
+  void Sample();
+  // Captures `num_samples` consecutive states as fast as possible.
+  void SampleWindow(uint32_t num_samples);
+
+  // Enqueues a record captured elsewhere (e.g., by a TraceHistory).
+  void Append(const TraceRecord& record);
+
+  // Pushes any state held back for repeat coalescing into the ring.
+  void FlushPending();
+
+  // Blocks until every record captured so far has been written to the sink.
+  void WaitUntilDrained();
+
+  // Total number of records discarded because the ring was full.
+  [[nodiscard]] uint32_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static DWORD WINAPI DrainThreadProc(LPVOID param);
+  void DrainLoop();
+  void Emit(const TraceRecord& record);
+  void Push(const TraceRecord& record);
+  // Pushes the kDropped record for any outstanding drops. Returns false if
+  // the ring is still full.
+  bool FlushDropNotice();
+
+  SPSCRing<TraceRecord, kCapacity> ring_;
+  TraceSink* sink_;
+  HANDLE thread_{nullptr};
+
+  std::atomic<bool> stop_requested_{false};
+  std::atomic<uint32_t> pushed_{0};
+  std::atomic<uint32_t> emitted_{0};
+  std::atomic<uint32_t> dropped_{0};
+
+  // Producer only.
+  TraceRecord pending_{};
+  bool has_pending_{false};
+  TraceRecord drop_notice_{};
+};
+
+// Fixed size "flight recorder" of the most recent state samples. Nothing is
+// emitted unless DumpTo is called, so it can run continuously during long
+// workloads and provide context leading up to an anomaly.
+class TraceHistory {
+ public:
+  static constexpr uint32_t kCapacity = 1024;
+
+  // Captures the current DMA/CACHE1 state, overwriting the oldest record once
+  // the history is full.
+  void Sample();
+
+  // Appends the retained records to `logger`, oldest first, and clears the
+  // history.
+  void DumpTo(TraceLogger* logger);
+
+ private:
+  TraceRecord records_[kCapacity];
+  uint32_t next_{0};
+  uint32_t count_{0};
+};
+
+#endif  // TRACE_LOGGER_H_
@@ -0,0 +1,48 @@
+#include "trace_registers.h"
+
+#include <cstdio>
+
+void FormatStateEntry(const StateEntry& state, char* buffer, size_t size) {
+  size_t offset = 0;
+  auto append = [&](const char* format, auto... args) {
+    if (offset >= size) {
+      return;
+    }
+    auto written = snprintf(buffer + offset, size - offset, format, args...);
+    if (written > 0) {
+      offset += written;
+    }
+  };
+
+  if (size) {
+    buffer[0] = 0;
+  }
+
+  for (uint32_t i = 0; i < kNumTraceRegisters; ++i) {
+    const auto& reg = kTraceRegisters[i];
+    auto value = state.values[i];
+    append(i ? " %s=0x%08X" : "%s=0x%08X", reg.name, value);
+
+    if (!reg.num_fields) {
+      continue;
+    }
+
+    append("{");
+    for (uint32_t field_index = 0; field_index < reg.num_fields;
+         ++field_index) {
+      const auto& field = reg.fields[field_index];
+      auto mask = field.width >= 32 ? 0xFFFFFFFF : ((1U << field.width) - 1);
+      auto field_value = (value >> field.shift) & mask;
+      if (field.in_place) {
+        field_value <<= field.shift;
+      }
+      const char* separator = field_index ? " " : "";
+      if (field.width == 1) {
+        append("%s%s=%u", separator, field.name, field_value);
+      } else {
+        append("%s%s=0x%X", separator, field.name, field_value);
+      }
+    }
+    append("}");
+  }
+}
@@ -0,0 +1,137 @@
+#ifndef TRACE_REGISTERS_H_
+#define TRACE_REGISTERS_H_
+
+#include <windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "nv2a_pfifo.h"
+
+// Named bit range within a register.
+struct RegisterField {
+  const char* name;
+  uint8_t shift;
+  uint8_t width;
+  // If true the field is printed masked in place rather than shifted down.
+  // Used for address fields whose low bits are implicitly zero so that they
+  // print as byte addresses/offsets.
+  bool in_place;
+};
+
+// Describes a register captured in every StateEntry.
+struct RegisterDescription {
+  const char* name;
+  uint32_t address;
+  const RegisterField* fields;
+  uint32_t num_fields;
+};
+
+template <size_t kNumFields>
+constexpr RegisterDescription DescribeRegister(
+    const char* name, uint32_t address,
+    const RegisterField (&fields)[kNumFields]) {
+  return {name, address, fields, kNumFields};
+}
+
+constexpr RegisterDescription DescribeRegister(const char* name,
+                                               uint32_t address) {
+  return {name, address, nullptr, 0};
+}
+
+inline constexpr RegisterField kDmaPushFields[] = {
+    {"ACCESS", 0, 1},
+    {"BUSY", 4, 1},
+    {"BUFFER_EMPTY", 8, 1},
+    {"SUSPENDED", 12, 1},
+    {"ACQUIRE", 16, 1},
+};
+
+inline constexpr RegisterField kPush0Fields[] = {
+    {"ACCESS", 0, 1},
+};
+
+inline constexpr RegisterField kPull0Fields[] = {
+    {"ACCESS", 0, 1},
+    {"HASH_FAILED", 4, 1},
+    {"HASH_BUSY", 12, 1},
+};
+
+inline constexpr RegisterField kCache1StatusFields[] = {
+    {"LOW_MARK_EMPTY", 4, 1},
+    {"HIGH_MARK_FULL", 8, 1},
+};
+
+inline constexpr RegisterField kDmaSubroutineFields[] = {
+    {"ACTIVE", 0, 1},
+    {"RETURN_OFFSET", 2, 27, true},
+};
+
+inline constexpr RegisterField kRamHashTableFields[] = {
+    {"BASE_ADDRESS", 4, 5},
+    {"SIZE", 16, 2},
+    {"SEARCH", 24, 2},
+};
+
+inline constexpr RegisterField kCtxSwitch1Fields[] = {
+    {"GRCLASS", 0, 8},
+};
+
+inline constexpr RegisterField kPgraphFifoFields[] = {
+    {"ACCESS", 0, 1},
+};
+
+// Registers captured by CaptureState, in output order. Adding an entry here is
+// all that is needed to trace another register. DMA_STATE is intentionally
+// omitted since its method count changes on nearly every sample, which defeats
+// repeat coalescing.
+inline constexpr RegisterDescription kTraceRegisters[] = {
+    DescribeRegister("DMA_GET", DMA_GET_ADDR),
+    DescribeRegister("DMA_PUT", DMA_PUT_ADDR),
+    DescribeRegister("CACHE1_GET", CACHE_GET_ADDR),
+    DescribeRegister("CACHE1_PUT", CACHE_PUT_ADDR),
+    DescribeRegister("DMA_PUSH", CACHE1_DMA_PUSH_STATE, kDmaPushFields),
+    DescribeRegister("PUSH0", CACHE1_PUSH0_STATE, kPush0Fields),
+    DescribeRegister("PULL0", CACHE1_PULL0_STATE, kPull0Fields),
+    DescribeRegister("CACHE1_STATUS", CACHE1_STATUS, kCache1StatusFields),
+    DescribeRegister("DMA_SUBROUTINE", DMA_SUBROUTINE, kDmaSubroutineFields),
+    DescribeRegister("RAMHT", RAM_HASHTABLE, kRamHashTableFields),
+    DescribeRegister("CTX_SWITCH1", CTX_SWITCH1, kCtxSwitch1Fields),
+    DescribeRegister("PGRAPH_FIFO", PGRAPH_STATE, kPgraphFifoFields),
+};
+
+inline constexpr uint32_t kNumTraceRegisters =
+    sizeof(kTraceRegisters) / sizeof(kTraceRegisters[0]);
+
+// Buffer size sufficient for FormatStateEntry output.
+inline constexpr size_t kMaxFormattedStateLength = 1024;
+
+struct StateEntry {
+  DWORD values[kNumTraceRegisters];
+};
+
+template <uint32_t kAddress>
+inline uint32_t ReadRegister() {
+  return *reinterpret_cast<volatile uint32_t*>(kAddress);
+}
+
+template <size_t... kIndices>
+inline void CaptureStateImpl(StateEntry* state_entry,
+                             std::index_sequence<kIndices...>) {
+  ((state_entry->values[kIndices] =
+        ReadRegister<kTraceRegisters[kIndices].address>()),
+   ...);
+}
+
+// Reads every register in kTraceRegisters. The reads are expanded at compile
+// time into straight-line loads from constant addresses.
+inline void CaptureState(StateEntry* state_entry) {
+  CaptureStateImpl(state_entry, std::make_index_sequence<kNumTraceRegisters>{});
+}
+
+// Formats `state` as space separated NAME=0xVALUE pairs followed by decoded
+// bitfields, e.g., "DMA_PUSH=0x00000011{ACCESS=1 BUSY=1 ...}".
+void FormatStateEntry(const StateEntry& state, char* buffer, size_t size);
+
+#endif  // TRACE_REGISTERS_H_